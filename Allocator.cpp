@@ -0,0 +1,137 @@
+#include "Allocator.h"
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+void* HeapAllocator::allocate(size_t size)
+{
+	return ::operator new(size, std::align_val_t(bufferAlignment));
+}
+
+void HeapAllocator::deallocate(void* pointer, size_t size)
+{
+	::operator delete(pointer, size, std::align_val_t(bufferAlignment));
+}
+
+PoolAllocator::PoolAllocator(Allocator& upstream, size_t maxCachedBytes)
+	:m_upstream(upstream)
+	, m_maxCachedBytes(maxCachedBytes)
+	, m_stats{}
+{}
+
+PoolAllocator::~PoolAllocator()
+{
+	trim();
+}
+
+void* PoolAllocator::allocate(size_t size)
+{
+	const size_t bucket = bucketSize(size);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.allocations++;
+		m_stats.buffersInUse++;
+		const auto found = m_buckets.find(bucket);
+		if (found != m_buckets.end() && !found->second.empty())
+		{
+			void* pointer = found->second.back();
+			found->second.pop_back();
+			m_stats.reuses++;
+			m_stats.cachedBuffers--;
+			m_stats.cachedBytes -= bucket;
+			return pointer;
+		}
+	}
+
+	try
+	{
+		return m_upstream.allocate(bucket);
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.buffersInUse--;
+		throw;
+	}
+}
+
+void PoolAllocator::deallocate(void* pointer, size_t size)
+{
+	if (pointer == nullptr)
+		return;
+
+	const size_t bucket = bucketSize(size);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.buffersInUse--;
+		if (m_stats.cachedBytes + bucket <= m_maxCachedBytes)
+		{
+			m_buckets[bucket].push_back(pointer);
+			m_stats.cachedBuffers++;
+			m_stats.cachedBytes += bucket;
+			return;
+		}
+	}
+	m_upstream.deallocate(pointer, bucket);
+}
+
+PoolStats PoolAllocator::stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void PoolAllocator::trim()
+{
+	std::map<size_t, std::vector<void*>> buckets;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		buckets.swap(m_buckets);
+		m_stats.cachedBuffers = 0;
+		m_stats.cachedBytes = 0;
+	}
+
+	for (const auto& bucket : buckets)
+	{
+		for (void* pointer : bucket.second)
+			m_upstream.deallocate(pointer, bucket.first);
+	}
+}
+
+size_t PoolAllocator::bucketSize(size_t size)
+{
+	if (size <= bufferAlignment)
+		return bufferAlignment;
+
+	// Multiples of an eighth of the largest power of two not above the size, but at least of the alignment.
+	size_t power = bufferAlignment;
+	while (power <= size / 2)
+		power *= 2;
+	const size_t step = std::max(bufferAlignment, power / 8);
+	if (size > SIZE_MAX - step)
+		throw std::bad_alloc();
+	return (size + step - 1) / step * step;
+}
+
+Allocator& heapAllocator()
+{
+	static HeapAllocator allocator;
+	return allocator;
+}
+
+// Local to a function so that bitmaps created during static initialization of other files can use it.
+static std::atomic<Allocator*>& currentDefaultAllocator()
+{
+	static std::atomic<Allocator*> allocator{ &heapAllocator() };
+	return allocator;
+}
+
+Allocator& defaultAllocator()
+{
+	return *currentDefaultAllocator().load(std::memory_order_acquire);
+}
+
+void setDefaultAllocator(Allocator& allocator)
+{
+	currentDefaultAllocator().store(&allocator, std::memory_order_release);
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// Every buffer returned by an Allocator starts at a multiple of this, which is a cache line and enough for any SIMD
+// load.
+constexpr size_t bufferAlignment = 64;
+
+// Source of the pixel buffers of bitmaps and of the scratch buffers used by the filters.
+class Allocator
+{
+public:
+	virtual ~Allocator() = default;
+
+	// Returns at least size bytes aligned to bufferAlignment. Throws std::bad_alloc if that fails.
+	virtual void* allocate(size_t size) = 0;
+	// Releases a buffer returned by allocate with the same size.
+	virtual void deallocate(void* pointer, size_t size) = 0;
+};
+
+// Aligned operator new and delete.
+class HeapAllocator : public Allocator
+{
+public:
+	void* allocate(size_t size) override;
+	void deallocate(void* pointer, size_t size) override;
+};
+
+struct PoolStats
+{
+	// Calls to allocate.
+	size_t allocations;
+	// Allocations that were served from a cached buffer instead of the upstream allocator.
+	size_t reuses;
+	// Buffers that were allocated and not deallocated yet.
+	size_t buffersInUse;
+	// Deallocated buffers kept for reuse and their total size.
+	size_t cachedBuffers;
+	size_t cachedBytes;
+};
+
+// Keeps deallocated buffers and hands them out again for later allocations of a similar size, so repeatedly filtering
+// bitmaps of the same size stops allocating once every buffer size has been seen. Sizes of at least 512 bytes are
+// rounded up to buckets of eight per power of two, which wastes at most 12.5%. Smaller sizes are rounded up to a
+// multiple of bufferAlignment, which wastes less than bufferAlignment bytes but relatively more. Thread safe.
+class PoolAllocator : public Allocator
+{
+public:
+	// Buffers are taken from upstream when no cached one fits. Once the cached buffers exceed maxCachedBytes further
+	// deallocated buffers are returned to upstream.
+	explicit PoolAllocator(Allocator& upstream, size_t maxCachedBytes = SIZE_MAX);
+	PoolAllocator(const PoolAllocator&) = delete;
+	// Buffers that are still in use must not be deallocated after the pool is destroyed.
+	~PoolAllocator() override;
+
+	PoolAllocator& operator= (const PoolAllocator&) = delete;
+
+	void* allocate(size_t size) override;
+	void deallocate(void* pointer, size_t size) override;
+
+	PoolStats stats() const;
+	// Returns all cached buffers to the upstream allocator.
+	void trim();
+
+	// Size of the buffers that allocations of size bytes are served with.
+	static size_t bucketSize(size_t size);
+
+private:
+	Allocator& m_upstream;
+	size_t m_maxCachedBytes;
+	mutable std::mutex m_mutex;
+	// Cached buffers by bucket size.
+	std::map<size_t, std::vector<void*>> m_buckets;
+	PoolStats m_stats;
+};
+
+// Allocator of HeapAllocator that exists for the lifetime of the program.
+Allocator& heapAllocator();
+// Allocator used by bitmaps that aren't given one. Initially heapAllocator().
+Allocator& defaultAllocator();
+// The allocator has to outlive every bitmap that uses it.
+void setDefaultAllocator(Allocator& allocator);
+
+// Lets standard containers use an Allocator.
+template <class T>
+class BufferAllocator
+{
+public:
+	using value_type = T;
+
+	explicit BufferAllocator(Allocator& allocator);
+	template <class U>
+	BufferAllocator(const BufferAllocator<U>& other);
+
+	T* allocate(size_t count);
+	void deallocate(T* pointer, size_t count);
+	Allocator& allocator() const;
+
+private:
+	Allocator* m_allocator;
+};
+
+// Scratch array of the filters. Created with the allocator of the bitmap being filtered.
+template <class T>
+using Buffer = std::vector<T, BufferAllocator<T>>;
+
+template <class T>
+inline BufferAllocator<T>::BufferAllocator(Allocator& allocator)
+	:m_allocator(&allocator)
+{}
+
+template <class T>
+template <class U>
+inline BufferAllocator<T>::BufferAllocator(const BufferAllocator<U>& other)
+	:m_allocator(&other.allocator())
+{}
+
+template <class T>
+inline T* BufferAllocator<T>::allocate(size_t count)
+{
+	return static_cast<T*>(m_allocator->allocate(count * sizeof(T)));
+}
+
+template <class T>
+inline void BufferAllocator<T>::deallocate(T* pointer, size_t count)
+{
+	m_allocator->deallocate(pointer, count * sizeof(T));
+}
+
+template <class T>
+inline Allocator& BufferAllocator<T>::allocator() const
+{
+	return *m_allocator;
+}
+
+template <class T, class U>
+inline bool operator== (const BufferAllocator<T>& lhs, const BufferAllocator<U>& rhs)
+{
+	return &lhs.allocator() == &rhs.allocator();
+}
+
+template <class T, class U>
+inline bool operator!= (const BufferAllocator<T>& lhs, const BufferAllocator<U>& rhs)
+{
+	return !(lhs == rhs);
+}
@@ -1,172 +1,159 @@
 #include "Bitmap.h"
+#include "Convolution.h"
+#include "FftConvolution.h"
+#include "Median.h"
+#include "IntegralImage.h"
+#include "GaussianBlur.h"
+#include "FilterPipeline.h"
+#include "HsvConversion.h"
+#include "LookupTable.h"
+#include "BmpStream.h"
+#include "PixelConversion.h"
+#include "Rasterizer.h"
+#include "Mesh.h"
+
+Bitmap::Storage::Storage(Allocator& allocator, size_t bytes)
+	:allocation(allocator.allocate(bytes))
+	, bytes(bytes)
+	, allocator(&allocator)
+	, readOnly(false)
+{}
 
-Bitmap::Bitmap(const Bitmap& bitmap)
-	:m_width(bitmap.m_width)
-	, m_height(bitmap.m_height)
-	, m_pixelData(new Color[bitmap.m_width * bitmap.m_height])
+Bitmap::Storage::Storage(std::unique_ptr<MappedFile> mappedFile, bool readOnly)
+	:allocation(nullptr)
+	, bytes(0)
+	, allocator(nullptr)
+	, mappedFile(std::move(mappedFile))
+	, readOnly(readOnly)
+{}
+
+Bitmap::Storage::~Storage()
 {
-	memcpy(m_pixelData, bitmap.m_pixelData, m_width * m_height);
+	if (allocation != nullptr)
+		allocator->deallocate(allocation, bytes);
 }
 
+Bitmap::Bitmap(const Bitmap& bitmap)
+	:m_pixelData(bitmap.m_pixelData)
+	, m_width(bitmap.m_width)
+	, m_height(bitmap.m_height)
+	, m_stride(bitmap.m_stride)
+	, m_allocator(bitmap.m_allocator)
+	, m_storage(bitmap.m_storage)
+{}
+
 Bitmap::Bitmap(Bitmap&& bitmap) noexcept
 	:m_pixelData(bitmap.m_pixelData)
 	, m_width(bitmap.m_width)
 	, m_height(bitmap.m_height)
+	, m_stride(bitmap.m_stride)
+	, m_allocator(bitmap.m_allocator)
+	, m_storage(std::move(bitmap.m_storage))
 {
 	bitmap.m_pixelData = nullptr;
 }
 
-Bitmap::Bitmap(int width, int height)
-	:m_pixelData(new Color[width * height])
+Bitmap::Bitmap(int width, int height, Allocator& allocator)
+	:m_pixelData(nullptr)
 	, m_width(width)
 	, m_height(height)
-{}
+	, m_stride(width)
+	, m_allocator(&allocator)
+{
+	allocatePixels();
+}
 
 Bitmap::~Bitmap()
 {
-	delete[] m_pixelData;
+	freePixels();
 }
 
-Bitmap::Bitmap(const char* filename) {
-	std::ifstream file(filename, std::ios::in | std::ios::binary);
-
-	if (file.fail())
-		throw std::runtime_error("Couldn't open file.");
-
-	const std::streampos start = file.tellg();
-	file.seekg(0, std::ios::end);
-	const std::streampos end = file.tellg();
-	uint32_t fileSize = uint32_t(end) - uint32_t(start);
-
-	file.seekg(start);
-
-	bmpFileHeader fileHeader;
-	file.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader));
-
-	if (fileHeader.type != 0x4D42)
-		throw std::runtime_error("File signature doesn't match the BMP file signature.");
-
-	uint32_t infoHeaderSize;
-	bmpInfoHeader infoHeader;
-
-	std::streampos infoHeaderStart = file.tellg();
-	file.read(reinterpret_cast<char*>(&infoHeaderSize), 4);
-	file.seekg(infoHeaderStart);
-
-	if (infoHeaderSize + sizeof(fileHeader) >= fileSize)
-		throw std::runtime_error("Headers too big.");
-
-	file.read(reinterpret_cast<char*>(&infoHeader), std::min(infoHeaderSize, static_cast<uint32_t>(sizeof(infoHeader))));
-
-	//std::cout << (infoHeader.height * (infoHeader.width * (infoHeader.bitCount / 8) + ((4 -((infoHeader.width * (infoHeader.bitCount / 8)) % 4)) % 4))) << "\n";
-	//std::cout << (fileSize - infoHeaderSize - sizeof(fileHeader)) << "\n";
-
-	m_width = infoHeader.width;
-	m_height = infoHeader.height;
-
-	m_pixelData = new Color[m_width * m_height];
+Bitmap::Bitmap(const char* filename, LoadMode mode)
+	:m_pixelData(nullptr)
+	, m_allocator(&defaultAllocator())
+{
+	BmpReader reader(filename);
 
-	file.seekg(fileHeader.offset, std::ios::beg);
+	m_width = reader.width();
+	m_height = reader.height();
+	m_stride = m_width;
 
-	if (infoHeader.bitCount == 24 && infoHeader.compression == bmpCompression::BI_RGB)
+	if (mode != LoadMode::Copy && reader.isMappable())
 	{
-		// Every row in a BMP image has to align to 32 bits.
-		int paddingSize = (4 - ((m_width * 3) % 4)) % 4;
-		char* padding = nullptr;
-		if (paddingSize) padding = new char[paddingSize];
-
-		for (int y = m_height - 1; y >= 0; y--)
-		{
-			for (int x = 0; x < m_width; x++)
-			{
-				file.read(reinterpret_cast<char*>(&getPixel(x, y)), 3);
-				setPixel(x, y, Color(getPixel(x, y).value << 8 | 0xFF));
-			}
-			if (paddingSize)
-				file.read(padding, paddingSize);
-		}
-		if (paddingSize)
-			delete[] padding;
+		const bool readOnly = mode == LoadMode::MapReadOnly;
+		auto mappedFile = std::make_unique<MappedFile>(filename, readOnly ? MappedFile::Access::ReadOnly : MappedFile::Access::CopyOnWrite);
+		if (reader.pixelOffset() + sizeof(Color) * static_cast<uint64_t>(m_width) * static_cast<uint64_t>(m_height) > mappedFile->size())
+			throw std::runtime_error("File too small for the image size.");
+
+		// The rows are stored bottom-up, so the first row of the image is the last one in the file.
+		Color* pixels = reinterpret_cast<Color*>(mappedFile->data() + reader.pixelOffset());
+		m_stride = -m_width;
+		m_pixelData = pixels + static_cast<ptrdiff_t>(m_height - 1) * m_width;
+		m_storage = std::make_shared<Storage>(std::move(mappedFile), readOnly);
+		return;
 	}
-	else if (infoHeader.bitCount == 32 && infoHeader.compression == bmpCompression::BI_BITFIELDS)
-	{
-		// Bitmasks match how the colors are stored inside this class - faster loading.
-		if (infoHeader.redBitmask == 0xFF000000 && infoHeader.greenBitmask == 0x00FF0000 && infoHeader.blueBitmask == 0x0000FF00)
-		{
-			// Iterating backwards because BMP pixel data starts from the bottom left corner of an image.
-			for (int y = m_height - 1; y >= 0; y--)
-			{
-				file.read(reinterpret_cast<char*>(&getPixel(0, y)), 4 * static_cast<std::streamsize>(infoHeader.width));
-			}
-		}
-		else
-		{
-			uint32_t redBitOffset   = __builtin_ctz(infoHeader.redBitmask);
-			uint32_t greenBitOffset = __builtin_ctz(infoHeader.greenBitmask);
-			uint32_t blueBitOffset  = __builtin_ctz(infoHeader.blueBitmask);
-			uint32_t alphaBitOffset = __builtin_ctz(infoHeader.alphaBitmask);
 
-			// Iterating backwards because BMP pixel data starts from the bottom left corner of an image.
-			for (int y = m_height - 1; y >= 0; y--)
-			{
-				for (int x = 0; x < m_width; x++)
-				{
-					uint32_t value;
-					file.read(reinterpret_cast<char*>(&value), 4);
-					setPixel(
-						x, y, 
-						Color(
-							static_cast<uint8_t>((value & infoHeader.redBitmask)   >> redBitOffset),
-							static_cast<uint8_t>((value & infoHeader.greenBitmask) >> greenBitOffset),
-							static_cast<uint8_t>((value & infoHeader.blueBitmask)  >> blueBitOffset),
-							static_cast<uint8_t>((value & infoHeader.alphaBitmask) >> alphaBitOffset)
-						)
-					);
-				}
-			}
-		}
-		
-	}
-	else
-	{
-		if (infoHeader.compression != bmpCompression::BI_BITFIELDS && infoHeader.compression != bmpCompression::BI_RGB)
-			throw std::runtime_error("Unsupported compression type.");
-		throw std::runtime_error("Unsupported color bitcount.");
-	}
-
-	file.close();
+	allocatePixels();
+	reader.readRows(0, m_height, *this);
 }
 
 Bitmap& Bitmap::operator= (const Bitmap& bitmap)
 {
-	if (&bitmap == this)
-		return *this;
-
-	delete[] m_pixelData;
-
-	m_pixelData = new Color[bitmap.m_width * bitmap.m_height];
-	memcpy(m_pixelData, bitmap.m_pixelData, bitmap.m_width * bitmap.m_height);
+	m_pixelData = bitmap.m_pixelData;
 	m_width = bitmap.m_width;
 	m_height = bitmap.m_height;
+	m_stride = bitmap.m_stride;
+	m_allocator = bitmap.m_allocator;
+	m_storage = bitmap.m_storage;
 
 	return *this;
 }
 
 Bitmap& Bitmap::operator= (Bitmap&& bitmap) noexcept
 {
-	delete[] m_pixelData;
+	if (&bitmap == this)
+		return *this;
 
 	m_width = bitmap.m_width;
 	m_height = bitmap.m_height;
+	m_stride = bitmap.m_stride;
 	m_pixelData = bitmap.m_pixelData;
+	m_allocator = bitmap.m_allocator;
+	m_storage = std::move(bitmap.m_storage);
 
 	bitmap.m_pixelData = nullptr;
 
 	return *this;
 }
 
+void Bitmap::allocatePixels()
+{
+	m_storage = std::make_shared<Storage>(*m_allocator, pixelBytes());
+	m_pixelData = static_cast<Color*>(m_storage->allocation);
+	m_stride = m_width;
+}
+
+void Bitmap::freePixels()
+{
+	m_storage.reset();
+	m_pixelData = nullptr;
+}
+
+void Bitmap::detach()
+{
+	// Keeps the shared pixels alive while they are copied.
+	const std::shared_ptr<Storage> shared = m_storage;
+	const Color* source = m_pixelData;
+	const int32_t sourceStride = m_stride;
+
+	allocatePixels();
+	for (int y = 0; y < m_height; y++)
+		memcpy(m_pixelData + static_cast<ptrdiff_t>(y) * m_width, source + static_cast<ptrdiff_t>(y) * sourceStride, sizeof(Color) * m_width);
+}
+
 void Bitmap::drawLine(int x1, int y1, int x2, int y2, const Color color)
 {
+	prepareWrite();
 	int x, y;
 
 	int deltaX = abs(x1 - x2);
@@ -186,7 +173,7 @@ void Bitmap::drawLine(int x1, int y1, int x2, int y2, const Color color)
 		for (x = x1; x != x2; x += stepX)
 		{
 			if (x >= 0 && x < m_width && y >= 0 && y < m_height)
-				setPixel(x, y, color);
+				rowUnchecked(y)[x] = color;
 
 			if (distance > 0)
 			{
@@ -206,7 +193,7 @@ void Bitmap::drawLine(int x1, int y1, int x2, int y2, const Color color)
 		for (y = y1; y != y2; y += stepY)
 		{
 			if (x >= 0 && x < m_width && y >= 0 && y < m_height)
-				setPixel(x, y, color);
+				rowUnchecked(y)[x] = color;
 
 			if (distance > 0)
 			{
@@ -228,264 +215,403 @@ void Bitmap::drawTriangle(int x1, int y1, int x2, int y2, int x3, int y3, Color
 
 void Bitmap::fillTriangle(float x1, float y1, float x2, float y2, float x3, float y3, Color color)
 {
-	// round here maybe idk
-	int minX = std::clamp(std::min(x1, std::min(x2, x3)), 0.f, static_cast<float>(m_width));
-	int maxX = std::clamp(std::max(x1, std::max(x2, x3)), 0.f, static_cast<float>(m_width));
-
-	int minY = std::clamp(std::min(y1, std::min(y2, y3)), 0.f, static_cast<float>(m_height));
-	int maxY = std::clamp(std::max(y1, std::max(y2, y3)), 0.f, static_cast<float>(m_height));
-
-	float area = (x1 - x3) * (y2 - y3) - (x2 - x3) * (y1 - y3);
-	float weight1, weight2, weight3;
-	bool hasNeg, hasPos;
-
-	for (float x = minX; x <= maxX; x++)
-	{
-		for (float y = minY; y <= maxY; y++)
-		{
-			// Calculate barycentric weights using 2D cross product
-			weight1 = (x - x2) * (y1 - y2) - (x1 - x2) * (y - y2);
-			weight2 = (x - x3) * (y2 - y3) - (x2 - x3) * (y - y3);
-			weight3 = (x - x1) * (y3 - y1) - (x3 - x1) * (y - y1);
-
-			hasNeg = (weight1 < 0) || (weight2 < 0) || (weight3 < 0);
-			hasPos = (weight1 > 0) || (weight2 > 0) || (weight3 > 0);
-
-			if (!(hasNeg && hasPos))
-				setPixel(x, y, color);
-		}
-	}
+	prepareWrite();
+	TriangleRasterizer rasterizer(x1, y1, x2, y2, x3, y3, 0, 0, m_width, m_height);
+	int32_t y, begin, end;
+	while (rasterizer.nextSpan(y, begin, end))
+		fillSpan(rowUnchecked(y) + begin, end - begin, color);
 }
 
 void Bitmap::fillTriangleInterpolate(float x1, float y1, float x2, float y2, float x3, float y3, Color color1, Color color2, Color color3)
 {
-	int minX = std::clamp(std::min(x1, std::min(x2, x3)), 0.f, static_cast<float>(m_width));
-	int maxX = std::clamp(std::max(x1, std::max(x2, x3)), 0.f, static_cast<float>(m_width));
-
-	int minY = std::clamp(std::min(y1, std::min(y2, y3)), 0.f, static_cast<float>(m_height));
-	int maxY = std::clamp(std::max(y1, std::max(y2, y3)), 0.f, static_cast<float>(m_height));
-
-	float area = (x1 - x3) * (y2 - y3) - (x2 - x3) * (y1 - y3);
-	float weight1, weight2, weight3;
-	bool hasNeg, hasPos;
-	float r, g, b, a;
+	fillTriangleInterpolate(x1, y1, 1, x2, y2, 1, x3, y3, 1, color1, color2, color3);
+}
 
-	for (float x = minX; x <= maxX; x++)
-	{
-		for (float y = minY; y <= maxY; y++)
-		{
-			// Calculate barycentric weights using 2D cross product
-			weight1 = (x - x2) * (y1 - y2) - (x1 - x2) * (y - y2);
-			weight2 = (x - x3) * (y2 - y3) - (x2 - x3) * (y - y3);
-			weight3 = (x - x1) * (y3 - y1) - (x3 - x1) * (y - y1);
+void Bitmap::fillTriangleInterpolate(float x1, float y1, float w1, float x2, float y2, float w2, float x3, float y3, float w3, Color color1, Color color2, Color color3)
+{
+	const ColorGradient gradient(x1, y1, x2, y2, x3, y3, color1, color2, color3, w1, w2, w3);
+	prepareWrite();
+	TriangleRasterizer rasterizer(x1, y1, x2, y2, x3, y3, 0, 0, m_width, m_height);
+	int32_t y, begin, end;
+	while (rasterizer.nextSpan(y, begin, end))
+		gradient.shadeSpan(rowUnchecked(y) + begin, begin, y, end - begin);
+}
 
-			hasNeg = (weight1 < 0) || (weight2 < 0) || (weight3 < 0);
-			hasPos = (weight1 > 0) || (weight2 > 0) || (weight3 > 0);
+void Bitmap::drawMesh(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, ThreadPool* pool)
+{
+	::drawMesh(*this, vertices, vertexCount, indices, indexCount, pool);
+}
 
-			if (!(hasNeg && hasPos))
-			{
-				weight1 /= area;
-				weight2 /= area;
-				weight3 /= area;
-
-				r = weight1 * color1.r + weight2 * color2.r + weight3 * color3.r;
-				g = weight1 * color1.g + weight2 * color2.g + weight3 * color3.g;
-				b = weight1 * color1.b + weight2 * color2.b + weight3 * color3.b;
-				a = weight1 * color1.a + weight2 * color2.a + weight3 * color3.a;
-				setPixel(x, y, Color(r, g, b, a));
-			}
-		}
-	}
+// Intersects the rectangle with [0, width) x [0, height). Returns false if nothing is left.
+static bool clipRect(const Rect& rect, int32_t width, int32_t height, int32_t& left, int32_t& top, int32_t& right, int32_t& bottom)
+{
+	// In 64 bits so that x + width can't overflow.
+	left = static_cast<int32_t>(std::max<int64_t>(rect.x, 0));
+	top = static_cast<int32_t>(std::max<int64_t>(rect.y, 0));
+	right = static_cast<int32_t>(std::min<int64_t>(static_cast<int64_t>(rect.x) + rect.width, width));
+	bottom = static_cast<int32_t>(std::min<int64_t>(static_cast<int64_t>(rect.y) + rect.height, height));
+	return left < right && top < bottom;
 }
 
 void Bitmap::drawRect(int x, int y, int width, int height, const Color color)
 {
-	for (int i = x; i < x + width; i++)
-	{
-		setPixel(i, y, color);
-		setPixel(i, y + height - 1, color);
-	}
-
-	for (int j = y; j < y + height; j++)
-	{
-		setPixel(x, j, color);
-		setPixel(x + width - 1, j, color);
-	}
+	const Rect rect{ x, y, width, height };
+	drawRects(&rect, 1, color);
 }
 
 void Bitmap::fillRect(int x, int y, int width, int height, const Color color)
 {
-	for (int i = x; i < x + width; i++)
+	const Rect rect{ x, y, width, height };
+	fillRects(&rect, 1, color);
+}
+
+void Bitmap::drawRects(const Rect* rects, size_t count, Color color)
+{
+	prepareWrite();
+	for (size_t i = 0; i < count; i++)
 	{
-		for (int j = y; j < y + height; j++)
+		const Rect& rect = rects[i];
+		if (rect.width <= 0 || rect.height <= 0)
+			continue;
+		int32_t left, top, right, bottom;
+		if (!clipRect(rect, m_width, m_height, left, top, right, bottom))
+			continue;
+
+		const int64_t lastX = static_cast<int64_t>(rect.x) + rect.width - 1;
+		const int64_t lastY = static_cast<int64_t>(rect.y) + rect.height - 1;
+		if (rect.y >= 0)
+			fillSpan(rowUnchecked(rect.y) + left, right - left, color);
+		if (lastY != rect.y && lastY < m_height)
+			fillSpan(rowUnchecked(static_cast<int32_t>(lastY)) + left, right - left, color);
+
+		// The sides without the corners, which belong to the top and bottom edges.
+		const int32_t sideTop = std::max(top, rect.y + 1);
+		const int32_t sideBottom = static_cast<int32_t>(std::min<int64_t>(bottom, lastY));
+		for (int32_t y = sideTop; y < sideBottom; y++)
 		{
-			setPixel(i, j, color);
+			Color* pixels = rowUnchecked(y);
+			if (rect.x >= 0)
+				pixels[rect.x] = color;
+			if (lastX != rect.x && lastX < m_width)
+				pixels[lastX] = color;
 		}
 	}
 }
 
-void Bitmap::drawBitmap(int x, int y, Bitmap& bitmap)
+void Bitmap::fillRects(const Rect* rects, size_t count, Color color)
 {
-	int minX = std::clamp(x, 0, m_width);
-	int minY = std::clamp(y, 0, m_height);
-	int maxX = std::clamp(x + bitmap.m_width, 0, m_width);
-	int maxY = std::clamp(y + bitmap.m_height, 0, m_height);
-
-	for (int i = minX; i < maxX; i++)
+	prepareWrite();
+	for (size_t i = 0; i < count; i++)
 	{
-		for (int j = minY; j < maxY; j++)
-		{
-			Color pixel = bitmap.getPixel(i - x, j - y);
-			if (pixel.a > 128)
-				setPixel(i, j, pixel);
-		}
+		int32_t left, top, right, bottom;
+		if (!clipRect(rects[i], m_width, m_height, left, top, right, bottom))
+			continue;
+		for (int32_t y = top; y < bottom; y++)
+			fillSpan(rowUnchecked(y) + left, right - left, color);
 	}
 }
 
-void Bitmap::applyConvolutionFilter(Matrix matrix)
+void Bitmap::drawBitmap(int x, int y, ConstBitmapView bitmap, BlendMode mode, AlphaMode alphaMode)
+{
+	int minX = std::clamp(x, 0, m_width);
+	int minY = std::clamp(y, 0, m_height);
+	int maxX = std::clamp(x + bitmap.width(), 0, m_width);
+	int maxY = std::clamp(y + bitmap.height(), 0, m_height);
+	if (minX >= maxX)
+		return;
+
+	prepareWrite();
+	for (int j = minY; j < maxY; j++)
+		blendRow(bitmap.row(j - y) + (minX - x), rowUnchecked(j) + minX, maxX - minX, mode, alphaMode);
+}
+
+void Bitmap::applyConvolutionFilter(Matrix matrix, ThreadPool* pool)
 {
 	// might change it to static_assert
 	if (!(matrix.width() & 1 && matrix.height() & 1))
 		throw std::runtime_error("Matrix width and height must be an odd number.");
 
-	int32_t halfMatWidth = matrix.width() / 2;
-	int32_t halfMatHeight = matrix.height() / 2;
-
-	Bitmap output(m_width, m_height);
+	std::vector<float> horizontal, vertical;
+	if (matrix.separate(horizontal, vertical))
+	{
+		applyConvolutionFilter(horizontal, vertical, pool);
+		return;
+	}
 
-	int32_t x, y, mX, mY;
-	float mVal;
-	Color currentColor;
-	for (y = 0; y < m_height; y++)
+	if (matrix.width() * matrix.height() >= fftConvolutionMinArea)
 	{
-		for (x = 0; x < m_width; x++)
-		{
-			float color[3]{ 0 };
-			for (mY = 0;  mY < matrix.height(); mY++)
-			{
-				for (mX = 0; mX < matrix.width(); mX++)
-				{
-					mVal = matrix.get(mX, mY);
-					currentColor = getPixel(std::clamp(x + mX - halfMatWidth, 0, m_width - 1), std::clamp(y + mY - halfMatHeight, 0, m_height - 1));
-					color[0] += currentColor.r * mVal;
-					color[1] += currentColor.g * mVal;
-					color[2] += currentColor.b * mVal;
-				}
-			}
-			output.setPixel(x, y, Color(std::clamp(color[0], 0.f, 255.f), std::clamp(color[1], 0.f, 255.f), std::clamp(color[2], 0.f, 255.f)));
-		}
+		applyConvolutionFilter(*FftKernel::cached(matrix), pool);
+		return;
 	}
+
+	Bitmap output(m_width, m_height, *m_allocator);
+	convolve(*this, output, matrix, pool);
 	*this = std::move(output);
 }
 
-void Bitmap::applyMedianFilter(size_t radius)
+void Bitmap::applyConvolutionFilter(const FftKernel& kernel, ThreadPool* pool)
 {
-	Bitmap output(m_width, m_height);
+	Bitmap output(m_width, m_height, *m_allocator);
+	convolveFft(*this, output, kernel, pool);
+	*this = std::move(output);
+}
 
-	int32_t x, y, mX, mY;
-	float mVal;
-	Color currentColor;
-	for (y = 0; y < m_height; y++)
-	{
-		for (x = 0; x < m_width; x++)
-		{
-			std::vector<std::pair<uint8_t, Color>> values;
-			for (mY = 0; mY < radius * 2 + 1; mY++)
-			{
-				for (mX = 0; mX < radius * 2 + 1; mX++)
-				{
-					currentColor = getPixel(std::clamp(x + mX - static_cast<int32_t>(radius), 0, m_width - 1), std::clamp(y + mY - static_cast<int32_t>(radius), 0, m_height - 1));
-					values.push_back(std::pair<uint8_t, Color>(currentColor.grayscale().r, currentColor));
-				}
-			}
-			struct {
-				bool operator()(std::pair<uint8_t, Color> a, std::pair<uint8_t, Color> b) const { return a.first < b.first; }
-			} customLess;
-			std::sort(values.begin(), values.end(), customLess);
-			int mid = ((radius * 2 + 1) * (radius * 2 + 1)) / 2;
-			output.setPixel(x, y, values[mid].second);
-		}
-	}
+void Bitmap::applyConvolutionFilter(const std::vector<float>& horizontal, const std::vector<float>& vertical, ThreadPool* pool)
+{
+	if (!(horizontal.size() & 1 && vertical.size() & 1))
+		throw std::runtime_error("Kernel sizes must be odd numbers.");
+
+	Bitmap output(m_width, m_height, *m_allocator);
+	convolveSeparable(*this, output, horizontal, vertical, pool);
 	*this = std::move(output);
 }
 
-void Bitmap::clear()
+void Bitmap::applyMedianFilter(size_t radius, ThreadPool* pool)
 {
-	memset(m_pixelData, 0, m_width * m_height * sizeof(Color));
+	Bitmap output(m_width, m_height, *m_allocator);
+	medianFilter(*this, output, static_cast<int32_t>(radius), pool);
+	*this = std::move(output);
 }
 
-void Bitmap::saveToPpm(const char* filename) const
+void Bitmap::applyBoxBlur(size_t radius, ThreadPool* pool)
+{
+	const IntegralImage integral(*this);
+	Bitmap output(m_width, m_height, *m_allocator);
+	boxBlur(integral, output, static_cast<int32_t>(std::min<size_t>(radius, INT32_MAX)), pool);
+	*this = std::move(output);
+}
+
+void Bitmap::applyGaussianBlur(float sigma, ThreadPool* pool)
 {
-	std::fstream file;
-	file.open(filename);
+	Bitmap output(m_width, m_height, *m_allocator);
+	gaussianBlur(*this, output, sigma, pool);
+	*this = std::move(output);
+}
 
-	file << "P3\n" << m_width << ' ' << m_height << "\n255\n";
+void Bitmap::applyFilterPipeline(const FilterPipeline& pipeline, ThreadPool* pool)
+{
+	Bitmap output(m_width, m_height, *m_allocator);
+	pipeline.apply(*this, output, pool);
+	*this = std::move(output);
+}
 
-	for (int y = 0; y < m_height; y++)
+void Bitmap::adjustHsv(float hueShift, float saturationFactor, float valueFactor, ThreadPool* pool)
+{
+	// Taking the view detaches shared pixels once, before the rows are handed to the threads.
+	const BitmapView pixels(*this);
+	parallelFor(pool, 0, m_height, 0, [&](int32_t firstRow, int32_t lastRow) {
+		for (int32_t y = firstRow; y < lastRow; y++)
+			::adjustHsv(pixels.row(y), m_width, hueShift, saturationFactor, valueFactor);
+	});
+}
+
+void Bitmap::applyLookupTable(const LookupTable& table, ThreadPool* pool)
+{
+	const BitmapView pixels(*this);
+	table.apply(pixels, pixels, pool);
+}
+
+void Bitmap::clear()
+{
+	// Every pixel is overwritten, so pixels that prepareWrite() would copy are replaced by new ones instead.
+	if (m_storage != nullptr && (m_storage.use_count() != 1 || m_storage->readOnly))
+		allocatePixels();
+	memset(begin(), 0, pixelBytes());
+}
+
+// Size of the buffers rows are converted in before writing or after reading. Every write and read call transfers
+// as many whole rows as fit.
+static constexpr size_t netpbmChunkSize = 1 << 20;
+
+template <typename ConvertRow>
+static void writeRowsBuffered(std::ofstream& file, ConstBitmapView bitmap, size_t rowSize, ConvertRow convertRow)
+{
+	const size_t chunkRows = std::max<size_t>(1, netpbmChunkSize / std::max<size_t>(1, rowSize));
+	std::vector<uint8_t> chunk(std::min(chunkRows, static_cast<size_t>(bitmap.height())) * rowSize);
+
+	for (int y = 0; y < bitmap.height();)
 	{
-		for (int x = 0; x < m_width; x++)
-		{
-			Color p = getPixel(x, y);
-			file << static_cast<int>(p.r) << '\t' << static_cast<int>(p.g) << '\t' << static_cast<int>(p.b) << '\n';
-		}
+		const size_t rows = std::min(chunkRows, static_cast<size_t>(bitmap.height() - y));
+		for (size_t i = 0; i < rows; i++, y++)
+			convertRow(bitmap.row(y), chunk.data() + i * rowSize);
+		file.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(rows * rowSize));
 	}
 
-	file.close();
+	if (file.fail())
+		throw std::runtime_error("Couldn't write to file.");
 }
 
-void Bitmap::saveToBmp(const char* filename, uint16_t bitCount) const
+template <typename ConvertRow>
+static void readRowsBuffered(std::ifstream& file, Bitmap& bitmap, size_t rowSize, ConvertRow convertRow)
 {
-	std::fstream file(filename, std::ios::out | std::ios::binary);
+	const size_t chunkRows = std::max<size_t>(1, netpbmChunkSize / std::max<size_t>(1, rowSize));
+	std::vector<uint8_t> chunk(std::min(chunkRows, static_cast<size_t>(bitmap.height())) * rowSize);
 
-	if (bitCount == 32)
+	for (int y = 0; y < bitmap.height();)
 	{
-		bmpFileHeader fileHeader{ 0x4D42, static_cast<uint32_t>(sizeof(bmpFileHeader)) + static_cast<uint32_t>(sizeof(bmpInfoHeader)) + 4 * static_cast<uint32_t>(m_width * m_height), 0, sizeof(bmpFileHeader) + sizeof(bmpInfoHeader) };
-		bmpInfoHeader infoHeader{ sizeof(bmpInfoHeader), static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height), 1, bitCount, bmpCompression::BI_BITFIELDS, 4 * static_cast<uint32_t>(m_height * m_width), 2835, 2835, 0, 0, 0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF, 0x57696E20 };
-
-		file.write(reinterpret_cast<char*>(&fileHeader), sizeof(bmpFileHeader));
-		file.write(reinterpret_cast<char*>(&infoHeader), sizeof(bmpInfoHeader));
+		const size_t rows = std::min(chunkRows, static_cast<size_t>(bitmap.height() - y));
+		if (!file.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(rows * rowSize)))
+			throw std::runtime_error("Unexpected end of file.");
+		for (size_t i = 0; i < rows; i++, y++)
+			convertRow(chunk.data() + i * rowSize, bitmap.row(y));
+	}
+}
 
-		// Iterating backwards because BMP pixel data starts from the bottom left corner of an image.
-		for (int y = m_height - 1; y >= 0; y--)
+// Reads a whitespace separated header token and the single whitespace character after it, skipping comments.
+static std::string readNetpbmToken(std::ifstream& file)
+{
+	std::string token;
+	int c;
+	while ((c = file.get()) != std::char_traits<char>::eof())
+	{
+		if (token.empty() && c == '#')
+		{
+			while ((c = file.get()) != std::char_traits<char>::eof() && c != '\n');
+			continue;
+		}
+		if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f')
 		{
-			file.write(
-				reinterpret_cast<char*>(m_pixelData) + sizeof(Color) * m_width * y,
-				static_cast<std::streamsize>(sizeof(Color)) * static_cast<std::streamsize>(m_width)
-			);
+			if (token.empty())
+				continue;
+			break;
 		}
+		token += static_cast<char>(c);
 	}
-	else if (bitCount == 24)
-	{
-		int paddingSize = (4 - ((m_width * 3) % 4)) % 4;
-		uint32_t imageSize = m_width * (m_height * 3 + paddingSize);
+	return token;
+}
 
-		bmpFileHeader fileHeader{ 0x4D42, static_cast<uint32_t>(sizeof(bmpFileHeader)) + static_cast<uint32_t>(sizeof(bmpInfoHeader)) + imageSize, 0, sizeof(bmpFileHeader) + sizeof(bmpInfoHeader) };
-		bmpInfoHeader infoHeader{ sizeof(bmpInfoHeader), static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height), 1, bitCount, bmpCompression::BI_RGB, imageSize, 2835, 2835, 0, 0, 0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF, 0x57696E20 };
+static int readNetpbmNumber(std::ifstream& file)
+{
+	const std::string token = readNetpbmToken(file);
+	if (token.empty() || token.size() > 9 || token.find_first_not_of("0123456789") != std::string::npos)
+		throw std::runtime_error("Invalid header.");
+	return std::stoi(token);
+}
 
-		file.write(reinterpret_cast<char*>(&fileHeader), sizeof(bmpFileHeader));
-		file.write(reinterpret_cast<char*>(&infoHeader), sizeof(bmpInfoHeader));
+void saveToPpm(ConstBitmapView pixels, const char* filename)
+{
+	std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (file.fail())
+		throw std::runtime_error("Couldn't open file.");
 
-		char* padding = nullptr;
-		if (paddingSize) padding = new char[paddingSize];
+	const int32_t width = pixels.width();
+	file << "P6\n" << width << ' ' << pixels.height() << "\n255\n";
+	writeRowsBuffered(file, pixels, static_cast<size_t>(width) * 3, [width](const Color* colors, uint8_t* bytes) {
+		colorsToRgb(colors, bytes, width);
+	});
+}
 
-		for (int y = m_height - 1; y >= 0; y--)
+void saveToPam(ConstBitmapView pixels, const char* filename)
+{
+	std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (file.fail())
+		throw std::runtime_error("Couldn't open file.");
+
+	const int32_t width = pixels.width();
+	file << "P7\nWIDTH " << width << "\nHEIGHT " << pixels.height() << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+	writeRowsBuffered(file, pixels, static_cast<size_t>(width) * 4, [width](const Color* colors, uint8_t* bytes) {
+		colorsToRgba(colors, bytes, width);
+	});
+}
+
+void Bitmap::saveToPpm(const char* filename) const
+{
+	::saveToPpm(*this, filename);
+}
+
+void Bitmap::saveToPam(const char* filename) const
+{
+	::saveToPam(*this, filename);
+}
+
+Bitmap Bitmap::fromPpm(const char* filename)
+{
+	std::ifstream file(filename, std::ios::in | std::ios::binary);
+	if (file.fail())
+		throw std::runtime_error("Couldn't open file.");
+
+	const std::string signature = readNetpbmToken(file);
+	if (signature != "P6" && signature != "P3")
+		throw std::runtime_error("File signature doesn't match the PPM file signature.");
+
+	const int width = readNetpbmNumber(file);
+	const int height = readNetpbmNumber(file);
+	if (readNetpbmNumber(file) != 255)
+		throw std::runtime_error("Unsupported maximum color value.");
+
+	Bitmap bitmap(width, height);
+	if (signature == "P6")
+	{
+		readRowsBuffered(file, bitmap, static_cast<size_t>(width) * 3, [width](const uint8_t* bytes, Color* colors) {
+			rgbToColors(bytes, colors, width);
+		});
+	}
+	else
+	{
+		for (int y = 0; y < height; y++)
 		{
-			for (int x = 0; x < m_width; x++)
+			for (int x = 0; x < width; x++)
 			{
-				uint32_t value = getPixel(x, y).value >> 8;
-				file.write(reinterpret_cast<const char*>(&value), 3);
+				const int r = readNetpbmNumber(file);
+				const int g = readNetpbmNumber(file);
+				const int b = readNetpbmNumber(file);
+				bitmap.setPixel(x, y, Color::clamp(r, g, b));
 			}
-			if (paddingSize)
-				file.write(padding, paddingSize);
 		}
-		if (paddingSize)
-			delete[] padding;
 	}
-	else
+	return bitmap;
+}
+
+Bitmap Bitmap::fromPam(const char* filename)
+{
+	std::ifstream file(filename, std::ios::in | std::ios::binary);
+	if (file.fail())
+		throw std::runtime_error("Couldn't open file.");
+
+	if (readNetpbmToken(file) != "P7")
+		throw std::runtime_error("File signature doesn't match the PAM file signature.");
+
+	int width = -1, height = -1, depth = -1, maxValue = -1;
+	for (std::string key = readNetpbmToken(file); key != "ENDHDR"; key = readNetpbmToken(file))
 	{
-		file.close();
-		throw std::runtime_error("Unsupported color bitcount.");
+		if (key == "WIDTH")
+			width = readNetpbmNumber(file);
+		else if (key == "HEIGHT")
+			height = readNetpbmNumber(file);
+		else if (key == "DEPTH")
+			depth = readNetpbmNumber(file);
+		else if (key == "MAXVAL")
+			maxValue = readNetpbmNumber(file);
+		else if (key == "TUPLTYPE")
+			readNetpbmToken(file);
+		else
+			throw std::runtime_error("Invalid header.");
 	}
 
-	file.close();
+	if (width < 0 || height < 0)
+		throw std::runtime_error("Invalid header.");
+	if (maxValue != 255)
+		throw std::runtime_error("Unsupported maximum color value.");
+	if (depth != 3 && depth != 4)
+		throw std::runtime_error("Unsupported depth.");
+
+	Bitmap bitmap(width, height);
+	readRowsBuffered(file, bitmap, static_cast<size_t>(width) * depth, [width, depth](const uint8_t* bytes, Color* colors) {
+		if (depth == 4)
+			rgbaToColors(bytes, colors, width);
+		else
+			rgbToColors(bytes, colors, width);
+	});
+	return bitmap;
+}
+
+void saveToBmp(ConstBitmapView pixels, const char* filename, uint16_t bitCount)
+{
+	BmpWriter writer(filename, pixels.width(), pixels.height(), bitCount);
+	writer.writeRows(pixels);
+}
+
+void Bitmap::saveToBmp(const char* filename, uint16_t bitCount) const
+{
+	::saveToBmp(*this, filename, bitCount);
 }
\ No newline at end of file
@@ -5,57 +5,189 @@
 #include <stdexcept>
 #include <algorithm>
 #include <cstring>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstddef>
+#include <string>
 
+#include "Allocator.h"
 #include "Color.h"
+#include "Blend.h"
+#include "BitmapView.h"
 #include "BmpHeaders.h"
 #include "Matrix.h"
 #include "intrinsics.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+
+class FftKernel;
+class FilterPipeline;
+class LookupTable;
+struct Vertex;
+
+struct Rect
+{
+	int32_t x;
+	int32_t y;
+	int32_t width;
+	int32_t height;
+};
 
 class Bitmap
 {
 public:
+	enum class LoadMode
+	{
+		// Decodes the pixels into memory owned by the bitmap.
+		Copy,
+		// The pixels reference a read-only memory mapping of the file. The first modification copies them into memory
+		// owned by the bitmap.
+		MapReadOnly,
+		// The pixels reference a private memory mapping of the file. Modified pages are copied by the OS.
+		MapCopyOnWrite
+	};
+
 	Bitmap() = delete;
+	// Copies share the pixels until one of them is modified, so copying is O(1). Every non-const member that can
+	// modify pixels, including pixelData(), row(), the drawing functions and the filters, first gives the bitmap its own
+	// copy of the pixels if they are shared with another bitmap. Pointers and views taken before copying the bitmap
+	// still point to the shared pixels, so writing through them changes the copies as well.
 	Bitmap(const Bitmap& bitmap);
 	Bitmap(Bitmap&& bitmap) noexcept;
-	Bitmap(int width, int height);
-	Bitmap(const char* filename);
+	// The pixels are allocated with the allocator, which also provides the scratch buffers of the filters applied to
+	// the bitmap. Has to outlive the bitmap.
+	Bitmap(int width, int height, Allocator& allocator = defaultAllocator());
+	// The map modes only apply to 32 bit BI_BITFIELDS files with the same channel layout as Color, which is what
+	// saveToBmp writes. Other files are always copied.
+	Bitmap(const char* filename, LoadMode mode = LoadMode::Copy);
 	~Bitmap();
 
 	Bitmap& operator= (const Bitmap& bitmap);
 	Bitmap& operator= (Bitmap&& bitmap) noexcept;
 
+	// Points to the top left pixel. Rows are stride() pixels apart, which is negative for a mapped bottom-up file.
 	Color* pixelData();
 	int32_t width() const;
 	int32_t height() const;
+	int32_t stride() const;
+	bool isMapped() const;
+	Allocator& allocator() const;
+	// The non-const row(), getPixel() and setPixel() check for shared pixels on every call, and the non-const
+	// getPixel() copies them even if the reference is only read. Loops over many pixels should take row() or
+	// pixelData() once, or read through a const reference to the bitmap.
+	Color* row(int y);
+	const Color* row(int y) const;
 	const Color& getPixel(int x, int y) const;
 	Color& getPixel(int x, int y);
 	void setPixel(int x, int y, const Color color);
+	// The pixels are always stored contiguously, but begin() is the bottom left pixel if the stride is negative.
 	Color* begin();
 	Color* end();
 
 	void drawLine(int x1, int y1, int x2, int y2, Color color);
 	void drawTriangle(int x1, int y1, int x2, int y2, int x3, int y3, Color color);
+	// Fills the pixels whose integer coordinates are inside of the triangle, with shared edges drawn only once.
+	// See TriangleRasterizer.
 	void fillTriangle(float x1, float y1, float x2, float y2, float x3, float y3, Color color);
+	// Same coverage as fillTriangle, with the vertex colors interpolated across the triangle. See ColorGradient.
 	void fillTriangleInterpolate(float x1, float y1, float x2, float y2, float x3, float y3, Color color1, Color color2, Color color3);
+	// Perspective correct interpolation for vertices with the given depths, which have to be positive.
+	void fillTriangleInterpolate(float x1, float y1, float w1, float x2, float y2, float w2, float x3, float y3, float w3, Color color1, Color color2, Color color3);
+	// Draws a batch of triangles with interpolated vertex colors, see drawMesh.
+	void drawMesh(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, ThreadPool* pool = nullptr);
+	// The rectangles are clipped to the bitmap and filled row by row. drawRect draws the one pixel wide outline.
 	void drawRect(int x, int y, int width, int height, const Color color);
 	void fillRect(int x, int y, int width, int height, const Color color);
-	void drawBitmap(int x, int y, Bitmap& bitmap);
+	// Same as calling drawRect or fillRect for every rectangle, in order.
+	void drawRects(const Rect* rects, size_t count, Color color);
+	void fillRects(const Rect* rects, size_t count, Color color);
+	// Composites the bitmap onto this one with its top left corner at (x, y), clipped to this bitmap. See blendRow.
+	void drawBitmap(int x, int y, ConstBitmapView bitmap, BlendMode mode = BlendMode::SourceOver, AlphaMode alphaMode = AlphaMode::Straight);
 
-	void applyConvolutionFilter(Matrix matrix);
-	void applyMedianFilter(size_t radius);
+	// The filters run on the calling thread unless a pool is given, in which case the image is split into bands of rows
+	// processed in parallel. The output doesn't depend on the number of threads.
+
+	// Separable matrices are detected and applied as two one dimensional passes. Other matrices with at least
+	// fftConvolutionMinArea elements are applied with FFTs.
+	void applyConvolutionFilter(Matrix matrix, ThreadPool* pool = nullptr);
+	// Applies a kernel that was already transformed with FFTs. Faster than passing the matrix when the same kernel is
+	// used for many bitmaps.
+	void applyConvolutionFilter(const FftKernel& kernel, ThreadPool* pool = nullptr);
+	// Applies the outer product of the kernels using a horizontal pass followed by a vertical pass.
+	void applyConvolutionFilter(const std::vector<float>& horizontal, const std::vector<float>& vertical, ThreadPool* pool = nullptr);
+	void applyMedianFilter(size_t radius, ThreadPool* pool = nullptr);
+	// Mean of the (2 * radius + 1)^2 window around each pixel, including the alpha channel. Uses an IntegralImage, so
+	// the cost doesn't depend on the radius.
+	void applyBoxBlur(size_t radius, ThreadPool* pool = nullptr);
+	// Recursive approximation of a Gaussian blur, including the alpha channel. The cost doesn't depend on sigma.
+	void applyGaussianBlur(float sigma, ThreadPool* pool = nullptr);
+	// Runs all stages of the pipeline tile by tile in a single pass. See FilterPipeline.
+	void applyFilterPipeline(const FilterPipeline& pipeline, ThreadPool* pool = nullptr);
+	// Shifts the hue and scales the saturation and value of every pixel in a single pass. See adjustHsv in
+	// HsvConversion.h.
+	void adjustHsv(float hueShift, float saturationFactor, float valueFactor, ThreadPool* pool = nullptr);
+	// Maps every channel through the table in a single pass. See LookupTable.
+	void applyLookupTable(const LookupTable& table, ThreadPool* pool = nullptr);
 	void clear();
 
+	// Binary P6, the alpha channel is dropped.
 	void saveToPpm(const char* filename) const;
+	// P7 with the RGB_ALPHA tuple type.
+	void saveToPam(const char* filename) const;
 	void saveToBmp(const char* filename, uint16_t bitCount = 32) const;
 
+	// Loads binary P6 and plain P3 files with a maximum value of 255.
+	static Bitmap fromPpm(const char* filename);
+	// Loads P7 files with a depth of 3 (RGB) or 4 (RGB_ALPHA) and a maximum value of 255.
+	static Bitmap fromPam(const char* filename);
+
 private:
+	// Allocates pixels for the current size that aren't shared, or releases the pixels. The stride becomes the width.
+	void allocatePixels();
+	void freePixels();
+	size_t pixelBytes() const;
+	// Called before the pixels are modified. Copies them unless this bitmap is the only one using them and they are
+	// writable.
+	void prepareWrite();
+	void detach();
+	// Non-const row without the check, for members that called prepareWrite() once before their loops.
+	Color* rowUnchecked(int y);
+
+	// Pixels shared by copies of a bitmap, freed together with the last of them.
+	struct Storage
+	{
+		Storage(Allocator& allocator, size_t bytes);
+		Storage(std::unique_ptr<MappedFile> mappedFile, bool readOnly);
+		Storage(const Storage&) = delete;
+		Storage& operator= (const Storage&) = delete;
+		~Storage();
+
+		// Allocation holding the pixels, or null if they are in the mapped file.
+		void* allocation;
+		size_t bytes;
+		Allocator* allocator;
+		std::unique_ptr<MappedFile> mappedFile;
+		bool readOnly;
+	};
+
 	Color* m_pixelData;
 	int32_t m_width;
 	int32_t m_height;
+	int32_t m_stride;
+	// Used for new pixel buffers, including the copy made by detach().
+	Allocator* m_allocator;
+	std::shared_ptr<Storage> m_storage;
 };
 
+// Same as the Bitmap members, for any view. A region of a bitmap can be saved without copying it first.
+void saveToPpm(ConstBitmapView pixels, const char* filename);
+void saveToPam(ConstBitmapView pixels, const char* filename);
+void saveToBmp(ConstBitmapView pixels, const char* filename, uint16_t bitCount = 32);
+
 inline Color* Bitmap::pixelData()
 {
+	prepareWrite();
 	return m_pixelData;
 }
 
@@ -68,26 +200,76 @@ inline int32_t Bitmap::height() const {
 	return m_height;
 }
 
+inline int32_t Bitmap::stride() const
+{
+	return m_stride;
+}
+
+inline bool Bitmap::isMapped() const
+{
+	return m_storage != nullptr && m_storage->mappedFile != nullptr;
+}
+
+inline Allocator& Bitmap::allocator() const
+{
+	return *m_allocator;
+}
+
+inline size_t Bitmap::pixelBytes() const
+{
+	return sizeof(Color) * static_cast<size_t>(m_width) * static_cast<size_t>(m_height);
+}
+
+inline Color* Bitmap::row(int y)
+{
+	prepareWrite();
+	return m_pixelData + static_cast<ptrdiff_t>(y) * m_stride;
+}
+
+inline Color* Bitmap::rowUnchecked(int y)
+{
+	return m_pixelData + static_cast<ptrdiff_t>(y) * m_stride;
+}
+
+inline const Color* Bitmap::row(int y) const
+{
+	return m_pixelData + static_cast<ptrdiff_t>(y) * m_stride;
+}
+
 inline const Color& Bitmap::getPixel(int x, int y) const
 {
-	return m_pixelData[y * m_width + x];
+	return row(y)[x];
 }
 
 inline Color& Bitmap::getPixel(int x, int y) {
-	return m_pixelData[y * m_width + x];
+	return row(y)[x];
 }
 
 inline void Bitmap::setPixel(int x, int y, const Color color)
 {
-	m_pixelData[y * m_width + x].value = color.value;
+	row(y)[x].value = color.value;
 }
 
 inline Color* Bitmap::begin()
 {
-	return m_pixelData;
+	prepareWrite();
+	return m_stride < 0 ? rowUnchecked(m_height - 1) : m_pixelData;
 }
 
 inline Color* Bitmap::end()
 {
-	return m_pixelData + m_width * m_height;
+	return begin() + static_cast<ptrdiff_t>(m_width) * m_height;
+}
+
+inline void Bitmap::prepareWrite()
+{
+	if (m_storage == nullptr)
+		return;
+
+	// use_count() is a relaxed load. The fence orders the writes that follow after the reads of copies that were
+	// released on other threads.
+	if (m_storage.use_count() == 1 && !m_storage->readOnly)
+		std::atomic_thread_fence(std::memory_order_acquire);
+	else
+		detach();
 }
\ No newline at end of file
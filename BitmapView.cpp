@@ -0,0 +1,47 @@
+#include "BitmapView.h"
+#include "Bitmap.h"
+#include <stdexcept>
+
+static void checkRegion(int32_t x, int32_t y, int32_t width, int32_t height, int32_t viewWidth, int32_t viewHeight)
+{
+	if (x < 0 || y < 0 || width < 0 || height < 0 || width > viewWidth - x || height > viewHeight - y)
+		throw std::runtime_error("Region outside of the view.");
+}
+
+BitmapView::BitmapView(Bitmap& bitmap)
+	:m_pixelData(bitmap.pixelData())
+	, m_width(bitmap.width())
+	, m_height(bitmap.height())
+	, m_stride(bitmap.stride())
+	, m_allocator(&bitmap.allocator())
+{}
+
+BitmapView BitmapView::region(int32_t x, int32_t y, int32_t width, int32_t height) const
+{
+	checkRegion(x, y, width, height, m_width, m_height);
+	return BitmapView(row(y) + x, width, height, m_stride, *m_allocator);
+}
+
+BitmapView BitmapView::flipped() const
+{
+	return BitmapView(m_height > 0 ? row(m_height - 1) : m_pixelData, m_width, m_height, -m_stride, *m_allocator);
+}
+
+ConstBitmapView::ConstBitmapView(const Bitmap& bitmap)
+	:m_pixelData(bitmap.row(0))
+	, m_width(bitmap.width())
+	, m_height(bitmap.height())
+	, m_stride(bitmap.stride())
+	, m_allocator(&bitmap.allocator())
+{}
+
+ConstBitmapView ConstBitmapView::region(int32_t x, int32_t y, int32_t width, int32_t height) const
+{
+	checkRegion(x, y, width, height, m_width, m_height);
+	return ConstBitmapView(row(y) + x, width, height, m_stride, *m_allocator);
+}
+
+ConstBitmapView ConstBitmapView::flipped() const
+{
+	return ConstBitmapView(m_height > 0 ? row(m_height - 1) : m_pixelData, m_width, m_height, -m_stride, *m_allocator);
+}
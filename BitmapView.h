@@ -0,0 +1,168 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "Allocator.h"
+#include "Color.h"
+
+class Bitmap;
+
+// Non-owning window into pixels that are stored elsewhere, like a region of a bitmap or a buffer of another library.
+// Rows are stride pixels apart. The stride can be larger than the width for a region or negative for bottom-up data,
+// in which case the pointer is still the top left pixel. Views are cheap to copy and are passed by value.
+// Filters allocate their scratch buffers with the allocator of the destination view, which is the allocator of the
+// bitmap for views of bitmaps.
+class BitmapView
+{
+public:
+	BitmapView(Color* pixels, int32_t width, int32_t height, int32_t stride, Allocator& allocator = defaultAllocator());
+	// The whole bitmap.
+	BitmapView(Bitmap& bitmap);
+
+	Color* pixelData() const;
+	int32_t width() const;
+	int32_t height() const;
+	int32_t stride() const;
+	Allocator& allocator() const;
+	Color* row(int32_t y) const;
+	Color& getPixel(int32_t x, int32_t y) const;
+	void setPixel(int32_t x, int32_t y, Color color) const;
+
+	// The pixels [x, x + width) x [y, y + height) of this view. Throws if they aren't all inside of it.
+	BitmapView region(int32_t x, int32_t y, int32_t width, int32_t height) const;
+	// The same pixels with the rows in the opposite order.
+	BitmapView flipped() const;
+
+private:
+	Color* m_pixelData;
+	int32_t m_width;
+	int32_t m_height;
+	int32_t m_stride;
+	Allocator* m_allocator;
+};
+
+// Read-only version of BitmapView, used for sources.
+class ConstBitmapView
+{
+public:
+	ConstBitmapView(const Color* pixels, int32_t width, int32_t height, int32_t stride, Allocator& allocator = defaultAllocator());
+	ConstBitmapView(const Bitmap& bitmap);
+	ConstBitmapView(const BitmapView& view);
+
+	const Color* pixelData() const;
+	int32_t width() const;
+	int32_t height() const;
+	int32_t stride() const;
+	Allocator& allocator() const;
+	const Color* row(int32_t y) const;
+	const Color& getPixel(int32_t x, int32_t y) const;
+
+	ConstBitmapView region(int32_t x, int32_t y, int32_t width, int32_t height) const;
+	ConstBitmapView flipped() const;
+
+private:
+	const Color* m_pixelData;
+	int32_t m_width;
+	int32_t m_height;
+	int32_t m_stride;
+	Allocator* m_allocator;
+};
+
+inline BitmapView::BitmapView(Color* pixels, int32_t width, int32_t height, int32_t stride, Allocator& allocator)
+	:m_pixelData(pixels)
+	, m_width(width)
+	, m_height(height)
+	, m_stride(stride)
+	, m_allocator(&allocator)
+{}
+
+inline Color* BitmapView::pixelData() const
+{
+	return m_pixelData;
+}
+
+inline int32_t BitmapView::width() const
+{
+	return m_width;
+}
+
+inline int32_t BitmapView::height() const
+{
+	return m_height;
+}
+
+inline int32_t BitmapView::stride() const
+{
+	return m_stride;
+}
+
+inline Allocator& BitmapView::allocator() const
+{
+	return *m_allocator;
+}
+
+inline Color* BitmapView::row(int32_t y) const
+{
+	return m_pixelData + static_cast<ptrdiff_t>(y) * m_stride;
+}
+
+inline Color& BitmapView::getPixel(int32_t x, int32_t y) const
+{
+	return row(y)[x];
+}
+
+inline void BitmapView::setPixel(int32_t x, int32_t y, Color color) const
+{
+	row(y)[x].value = color.value;
+}
+
+inline ConstBitmapView::ConstBitmapView(const Color* pixels, int32_t width, int32_t height, int32_t stride, Allocator& allocator)
+	:m_pixelData(pixels)
+	, m_width(width)
+	, m_height(height)
+	, m_stride(stride)
+	, m_allocator(&allocator)
+{}
+
+inline ConstBitmapView::ConstBitmapView(const BitmapView& view)
+	:m_pixelData(view.pixelData())
+	, m_width(view.width())
+	, m_height(view.height())
+	, m_stride(view.stride())
+	, m_allocator(&view.allocator())
+{}
+
+inline const Color* ConstBitmapView::pixelData() const
+{
+	return m_pixelData;
+}
+
+inline int32_t ConstBitmapView::width() const
+{
+	return m_width;
+}
+
+inline int32_t ConstBitmapView::height() const
+{
+	return m_height;
+}
+
+inline int32_t ConstBitmapView::stride() const
+{
+	return m_stride;
+}
+
+inline Allocator& ConstBitmapView::allocator() const
+{
+	return *m_allocator;
+}
+
+inline const Color* ConstBitmapView::row(int32_t y) const
+{
+	return m_pixelData + static_cast<ptrdiff_t>(y) * m_stride;
+}
+
+inline const Color& ConstBitmapView::getPixel(int32_t x, int32_t y) const
+{
+	return row(y)[x];
+}
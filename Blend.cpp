@@ -0,0 +1,230 @@
+#include "Blend.h"
+#include "intrinsics.h"
+#include <algorithm>
+
+// All versions work on the channels in memory order, a, b, g, r, scaled to [0, 255], and do the same float
+// operations in the same order. Source and destination are premultiplied first if they are straight, the blend is
+// computed on premultiplied values and the result is divided by its alpha again.
+
+constexpr float inverse255 = 1.f / 255.f;
+
+template <BlendMode mode, AlphaMode alphaMode>
+static void blendRowScalar(const Color* source, Color* destination, int32_t begin, int32_t end)
+{
+	for (int32_t x = begin; x < end; x++)
+	{
+		const Color sourcePixel = source[x];
+		const Color destinationPixel = destination[x];
+		float s[4]{ static_cast<float>(sourcePixel.a), static_cast<float>(sourcePixel.b), static_cast<float>(sourcePixel.g), static_cast<float>(sourcePixel.r) };
+		float d[4]{ static_cast<float>(destinationPixel.a), static_cast<float>(destinationPixel.b), static_cast<float>(destinationPixel.g), static_cast<float>(destinationPixel.r) };
+		const float sourceAlpha = s[0] * inverse255;
+		const float destinationAlpha = d[0] * inverse255;
+		if (alphaMode == AlphaMode::Straight)
+		{
+			for (int i = 1; i < 4; i++)
+			{
+				s[i] = s[i] * sourceAlpha;
+				d[i] = d[i] * destinationAlpha;
+			}
+		}
+
+		float o[4];
+		for (int i = 0; i < 4; i++)
+		{
+			switch (mode)
+			{
+			case BlendMode::SourceOver:
+				o[i] = s[i] + d[i] * (1.f - sourceAlpha);
+				break;
+			case BlendMode::Multiply:
+				o[i] = s[i] * (1.f - destinationAlpha) + d[i] * (1.f - sourceAlpha) + s[i] * d[i] * inverse255;
+				break;
+			case BlendMode::Screen:
+				o[i] = s[i] + d[i] - s[i] * d[i] * inverse255;
+				break;
+			case BlendMode::Additive:
+				o[i] = std::min(s[i] + d[i], 255.f);
+				break;
+			}
+		}
+
+		if (alphaMode == AlphaMode::Straight)
+		{
+			const float factor = o[0] > 0 ? 255.f / o[0] : 0.f;
+			for (int i = 1; i < 4; i++)
+				o[i] = o[i] * factor;
+		}
+
+		uint8_t channels[4];
+		for (int i = 0; i < 4; i++)
+			channels[i] = static_cast<uint8_t>(std::min(std::max(o[i] + 0.5f, 0.f), 255.f));
+		destination[x] = Color(channels[3], channels[2], channels[1], channels[0]);
+	}
+}
+
+#ifdef BITMAP_X86
+
+// Blends one pixel. Lane 0 is the alpha.
+template <BlendMode mode, AlphaMode alphaMode>
+TARGET_SSE41 static inline __m128 blendPixelSse41(__m128 s, __m128 d)
+{
+	const __m128 inverse = _mm_set1_ps(inverse255);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 sourceAlpha = _mm_mul_ps(_mm_shuffle_ps(s, s, 0), inverse);
+	const __m128 destinationAlpha = _mm_mul_ps(_mm_shuffle_ps(d, d, 0), inverse);
+	if (alphaMode == AlphaMode::Straight)
+	{
+		s = _mm_blend_ps(_mm_mul_ps(s, sourceAlpha), s, 0x1);
+		d = _mm_blend_ps(_mm_mul_ps(d, destinationAlpha), d, 0x1);
+	}
+
+	__m128 o;
+	switch (mode)
+	{
+	case BlendMode::SourceOver:
+		o = _mm_add_ps(s, _mm_mul_ps(d, _mm_sub_ps(one, sourceAlpha)));
+		break;
+	case BlendMode::Multiply:
+		o = _mm_add_ps(_mm_add_ps(_mm_mul_ps(s, _mm_sub_ps(one, destinationAlpha)), _mm_mul_ps(d, _mm_sub_ps(one, sourceAlpha))), _mm_mul_ps(_mm_mul_ps(s, d), inverse));
+		break;
+	case BlendMode::Screen:
+		o = _mm_sub_ps(_mm_add_ps(s, d), _mm_mul_ps(_mm_mul_ps(s, d), inverse));
+		break;
+	case BlendMode::Additive:
+		o = _mm_min_ps(_mm_add_ps(s, d), _mm_set1_ps(255.f));
+		break;
+	}
+
+	if (alphaMode == AlphaMode::Straight)
+	{
+		const __m128 alpha = _mm_shuffle_ps(o, o, 0);
+		const __m128 factor = _mm_and_ps(_mm_div_ps(_mm_set1_ps(255.f), alpha), _mm_cmpgt_ps(alpha, _mm_setzero_ps()));
+		o = _mm_blend_ps(_mm_mul_ps(o, factor), o, 0x1);
+	}
+	return _mm_min_ps(_mm_max_ps(_mm_add_ps(o, _mm_set1_ps(0.5f)), _mm_setzero_ps()), _mm_set1_ps(255.f));
+}
+
+// Same as blendPixelSse41 for two pixels, one in each half.
+template <BlendMode mode, AlphaMode alphaMode>
+TARGET_AVX2 static inline __m256 blendPixelsAvx2(__m256 s, __m256 d)
+{
+	const __m256 inverse = _mm256_set1_ps(inverse255);
+	const __m256 one = _mm256_set1_ps(1.f);
+	const __m256 sourceAlpha = _mm256_mul_ps(_mm256_permute_ps(s, 0), inverse);
+	const __m256 destinationAlpha = _mm256_mul_ps(_mm256_permute_ps(d, 0), inverse);
+	if (alphaMode == AlphaMode::Straight)
+	{
+		s = _mm256_blend_ps(_mm256_mul_ps(s, sourceAlpha), s, 0x11);
+		d = _mm256_blend_ps(_mm256_mul_ps(d, destinationAlpha), d, 0x11);
+	}
+
+	__m256 o;
+	switch (mode)
+	{
+	case BlendMode::SourceOver:
+		o = _mm256_add_ps(s, _mm256_mul_ps(d, _mm256_sub_ps(one, sourceAlpha)));
+		break;
+	case BlendMode::Multiply:
+		o = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(s, _mm256_sub_ps(one, destinationAlpha)), _mm256_mul_ps(d, _mm256_sub_ps(one, sourceAlpha))), _mm256_mul_ps(_mm256_mul_ps(s, d), inverse));
+		break;
+	case BlendMode::Screen:
+		o = _mm256_sub_ps(_mm256_add_ps(s, d), _mm256_mul_ps(_mm256_mul_ps(s, d), inverse));
+		break;
+	case BlendMode::Additive:
+		o = _mm256_min_ps(_mm256_add_ps(s, d), _mm256_set1_ps(255.f));
+		break;
+	}
+
+	if (alphaMode == AlphaMode::Straight)
+	{
+		const __m256 alpha = _mm256_permute_ps(o, 0);
+		const __m256 factor = _mm256_and_ps(_mm256_div_ps(_mm256_set1_ps(255.f), alpha), _mm256_cmp_ps(alpha, _mm256_setzero_ps(), _CMP_GT_OQ));
+		o = _mm256_blend_ps(_mm256_mul_ps(o, factor), o, 0x11);
+	}
+	return _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(o, _mm256_set1_ps(0.5f)), _mm256_setzero_ps()), _mm256_set1_ps(255.f));
+}
+
+TARGET_SSE41 static inline __m128 loadPixelSse41(const Color* pixel)
+{
+	return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(pixel->value))));
+}
+
+template <BlendMode mode, AlphaMode alphaMode>
+TARGET_SSE41 static void blendRowSse41(const Color* source, Color* destination, int32_t begin, int32_t end)
+{
+	int32_t x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		__m128i pixels[4];
+		for (int i = 0; i < 4; i++)
+			pixels[i] = _mm_cvttps_epi32(blendPixelSse41<mode, alphaMode>(loadPixelSse41(source + x + i), loadPixelSse41(destination + x + i)));
+		const __m128i packed = _mm_packus_epi16(_mm_packus_epi32(pixels[0], pixels[1]), _mm_packus_epi32(pixels[2], pixels[3]));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x), packed);
+	}
+	blendRowScalar<mode, alphaMode>(source, destination, x, end);
+}
+
+TARGET_AVX2 static inline __m256 loadPixelPairAvx2(const Color* pixels)
+{
+	return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixels))));
+}
+
+template <BlendMode mode, AlphaMode alphaMode>
+TARGET_AVX2 static void blendRowAvx2(const Color* source, Color* destination, int32_t begin, int32_t end)
+{
+	// Packing pairs of pixels interleaves them across the halves, which the permutation undoes.
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		__m256i pixels[4];
+		for (int i = 0; i < 4; i++)
+			pixels[i] = _mm256_cvttps_epi32(blendPixelsAvx2<mode, alphaMode>(loadPixelPairAvx2(source + x + 2 * i), loadPixelPairAvx2(destination + x + 2 * i)));
+		const __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(pixels[0], pixels[1]), _mm256_packus_epi32(pixels[2], pixels[3]));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + x), _mm256_permutevar8x32_epi32(packed, order));
+	}
+	blendRowSse41<mode, alphaMode>(source, destination, x, end);
+}
+
+#endif
+
+template <BlendMode mode, AlphaMode alphaMode>
+static void blendRow(const Color* source, Color* destination, int32_t count)
+{
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		return blendRowAvx2<mode, alphaMode>(source, destination, 0, count);
+	case SimdLevel::Sse41:
+		return blendRowSse41<mode, alphaMode>(source, destination, 0, count);
+	default:
+		break;
+	}
+#endif
+	blendRowScalar<mode, alphaMode>(source, destination, 0, count);
+}
+
+template <BlendMode mode>
+static void blendRow(const Color* source, Color* destination, int32_t count, AlphaMode alphaMode)
+{
+	if (alphaMode == AlphaMode::Straight)
+		blendRow<mode, AlphaMode::Straight>(source, destination, count);
+	else
+		blendRow<mode, AlphaMode::Premultiplied>(source, destination, count);
+}
+
+void blendRow(const Color* source, Color* destination, int32_t count, BlendMode mode, AlphaMode alphaMode)
+{
+	switch (mode)
+	{
+	case BlendMode::SourceOver:
+		return blendRow<BlendMode::SourceOver>(source, destination, count, alphaMode);
+	case BlendMode::Multiply:
+		return blendRow<BlendMode::Multiply>(source, destination, count, alphaMode);
+	case BlendMode::Screen:
+		return blendRow<BlendMode::Screen>(source, destination, count, alphaMode);
+	case BlendMode::Additive:
+		return blendRow<BlendMode::Additive>(source, destination, count, alphaMode);
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+
+#include "Color.h"
+
+// How the colors of a source pixel and the destination pixel below it are combined. Every mode composites the result
+// over the destination with the source alpha, like the separable blend modes of the W3C compositing specification.
+enum class BlendMode
+{
+	// Porter-Duff source over.
+	SourceOver,
+	// Source times destination, which darkens.
+	Multiply,
+	// Inverse of multiplying the inverses, which lightens.
+	Screen,
+	// Porter-Duff plus. Colors and alphas are added and saturate.
+	Additive
+};
+
+enum class AlphaMode
+{
+	// The color channels are independent of the alpha.
+	Straight,
+	// The color channels have already been multiplied with the alpha. The result is premultiplied as well.
+	Premultiplied
+};
+
+// Blends count source pixels onto the destination pixels. The math is done in float for both alpha modes and the
+// results are rounded to the nearest integer. The SIMD versions give the same results as the scalar one.
+void blendRow(const Color* source, Color* destination, int32_t count, BlendMode mode, AlphaMode alphaMode);
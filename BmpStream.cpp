@@ -0,0 +1,237 @@
+#include "BmpStream.h"
+#include "PixelConversion.h"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+// Size of the buffers the pixel array is read into and packed in before writing. Big enough to make the number of
+// reads and writes negligible.
+static constexpr size_t readChunkSize = 1 << 20;
+static constexpr size_t writeChunkSize = 1 << 20;
+
+static bool hasColorBitmasks(const bmpInfoHeader& infoHeader)
+{
+	return infoHeader.bitCount == 32 && infoHeader.compression == bmpCompression::BI_BITFIELDS
+		&& infoHeader.redBitmask == 0xFF000000 && infoHeader.greenBitmask == 0x00FF0000 && infoHeader.blueBitmask == 0x0000FF00;
+}
+
+BmpReader::BmpReader(const char* filename)
+	:m_file(filename, std::ios::in | std::ios::binary)
+{
+	if (m_file.fail())
+		throw std::runtime_error("Couldn't open file.");
+
+	const std::streampos start = m_file.tellg();
+	m_file.seekg(0, std::ios::end);
+	const std::streampos end = m_file.tellg();
+	uint32_t fileSize = uint32_t(end) - uint32_t(start);
+
+	m_file.seekg(start);
+
+	m_file.read(reinterpret_cast<char*>(&m_fileHeader), sizeof(m_fileHeader));
+
+	if (m_fileHeader.type != 0x4D42)
+		throw std::runtime_error("File signature doesn't match the BMP file signature.");
+
+	uint32_t infoHeaderSize;
+
+	std::streampos infoHeaderStart = m_file.tellg();
+	m_file.read(reinterpret_cast<char*>(&infoHeaderSize), 4);
+	m_file.seekg(infoHeaderStart);
+
+	if (infoHeaderSize + sizeof(m_fileHeader) >= fileSize)
+		throw std::runtime_error("Headers too big.");
+
+	m_file.read(reinterpret_cast<char*>(&m_infoHeader), std::min(infoHeaderSize, static_cast<uint32_t>(sizeof(m_infoHeader))));
+
+	m_width = m_infoHeader.width;
+	m_height = m_infoHeader.height;
+	// A width of 0 is read as empty rows. Negative widths would make the row size wrap around.
+	if (m_width < 0)
+		throw std::runtime_error("Invalid image width.");
+
+	if (m_infoHeader.bitCount == 24 && m_infoHeader.compression == bmpCompression::BI_RGB)
+	{
+		// Every row in a BMP image has to align to 32 bits.
+		m_rowSize = (static_cast<size_t>(m_width) * 3 + 3) & ~static_cast<size_t>(3);
+	}
+	else if (m_infoHeader.bitCount == 32 && m_infoHeader.compression == bmpCompression::BI_BITFIELDS)
+	{
+		m_rowSize = static_cast<size_t>(m_width) * 4;
+	}
+	else
+	{
+		if (m_infoHeader.compression != bmpCompression::BI_BITFIELDS && m_infoHeader.compression != bmpCompression::BI_RGB)
+			throw std::runtime_error("Unsupported compression type.");
+		throw std::runtime_error("Unsupported color bitcount.");
+	}
+}
+
+bool BmpReader::isMappable() const
+{
+	return hasColorBitmasks(m_infoHeader) && m_fileHeader.offset % alignof(Color) == 0;
+}
+
+void BmpReader::readRows(int32_t top, int32_t count, BitmapView destination, int32_t destinationRow)
+{
+	if (top < 0 || count < 0 || top + count > m_height || destination.width() != m_width || destinationRow < 0 || destinationRow + count > destination.height())
+		throw std::runtime_error("Rows out of range.");
+
+	// BMP pixel data starts from the bottom left corner of an image, so the last requested row comes first in the file.
+	const uint64_t firstFileRow = static_cast<uint64_t>(m_height) - top - count;
+	m_file.clear();
+	m_file.seekg(static_cast<std::streamoff>(m_fileHeader.offset + firstFileRow * m_rowSize), std::ios::beg);
+
+	// Bitmasks match how the colors are stored inside this class - faster loading.
+	if (hasColorBitmasks(m_infoHeader))
+	{
+		for (int32_t y = destinationRow + count - 1; y >= destinationRow; y--)
+		{
+			if (!m_file.read(reinterpret_cast<char*>(destination.row(y)), static_cast<std::streamsize>(m_rowSize)))
+				throw std::runtime_error("Unexpected end of file.");
+		}
+		return;
+	}
+
+	const size_t pixelBytes = static_cast<size_t>(m_width) * (m_infoHeader.bitCount / 8);
+	const size_t chunkRows = std::max<size_t>(1, readChunkSize / std::max<size_t>(1, m_rowSize));
+	std::vector<uint8_t> chunk(std::min(chunkRows, static_cast<size_t>(count)) * m_rowSize);
+	const ChannelBitmasks masks{ m_infoHeader.redBitmask, m_infoHeader.greenBitmask, m_infoHeader.blueBitmask, m_infoHeader.alphaBitmask };
+
+	int32_t y = destinationRow + count - 1;
+	while (y >= destinationRow)
+	{
+		const size_t rows = std::min(chunkRows, static_cast<size_t>(y - destinationRow) + 1);
+		m_file.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(rows * m_rowSize));
+		// The padding of the last row of the file is allowed to be missing.
+		if (static_cast<size_t>(m_file.gcount()) < (rows - 1) * m_rowSize + pixelBytes)
+			throw std::runtime_error("Unexpected end of file.");
+
+		for (size_t i = 0; i < rows; i++, y--)
+		{
+			const uint8_t* pixels = chunk.data() + i * m_rowSize;
+			if (m_infoHeader.bitCount == 24)
+				bgrToColors(pixels, destination.row(y), m_width);
+			else
+				maskedToColors(pixels, destination.row(y), m_width, masks);
+		}
+	}
+}
+
+Bitmap BmpReader::readRows(int32_t top, int32_t count)
+{
+	Bitmap rows(m_width, count);
+	readRows(top, count, rows);
+	return rows;
+}
+
+void BmpReader::readBands(int32_t bandHeight, int32_t haloRows, const std::function<void(Bitmap& pixels, const BmpBand& band)>& callback)
+{
+	if (bandHeight <= 0 || haloRows < 0)
+		throw std::runtime_error("Invalid band size.");
+
+	for (int32_t bottom = m_height; bottom > 0; bottom -= bandHeight)
+	{
+		const int32_t top = std::max(0, bottom - bandHeight);
+		const BmpBand band{ top, bottom - top, std::min(haloRows, top), std::min(haloRows, m_height - bottom) };
+		Bitmap pixels = readRows(top - band.haloAbove, band.haloAbove + band.rows + band.haloBelow);
+		callback(pixels, band);
+	}
+}
+
+BmpWriter::BmpWriter(const char* filename, int32_t width, int32_t height, uint16_t bitCount)
+	:m_width(width)
+	, m_height(height)
+	, m_bitCount(bitCount)
+	, m_rowsWritten(0)
+{
+	if (bitCount != 32 && bitCount != 24)
+		throw std::runtime_error("Unsupported color bitcount.");
+
+	m_file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (m_file.fail())
+		throw std::runtime_error("Couldn't open file.");
+
+	if (bitCount == 32)
+	{
+		// The pixel data is aligned to 4 bytes so the file can be loaded with LoadMode::MapReadOnly or LoadMode::MapCopyOnWrite.
+		const uint32_t headersSize = static_cast<uint32_t>(sizeof(bmpFileHeader)) + static_cast<uint32_t>(sizeof(bmpInfoHeader));
+		const uint32_t pixelOffset = (headersSize + 3) & ~3u;
+		const char gap[4]{ 0 };
+
+		bmpFileHeader fileHeader{ 0x4D42, pixelOffset + 4 * static_cast<uint32_t>(m_width * m_height), 0, pixelOffset };
+		bmpInfoHeader infoHeader{ sizeof(bmpInfoHeader), static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height), 1, bitCount, bmpCompression::BI_BITFIELDS, 4 * static_cast<uint32_t>(m_height * m_width), 2835, 2835, 0, 0, 0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF, 0x57696E20 };
+
+		m_file.write(reinterpret_cast<char*>(&fileHeader), sizeof(bmpFileHeader));
+		m_file.write(reinterpret_cast<char*>(&infoHeader), sizeof(bmpInfoHeader));
+		m_file.write(gap, pixelOffset - headersSize);
+	}
+	else
+	{
+		const uint32_t rowSize = (static_cast<uint32_t>(m_width) * 3 + 3) & ~3u;
+		const uint32_t imageSize = rowSize * static_cast<uint32_t>(m_height);
+
+		bmpFileHeader fileHeader{ 0x4D42, static_cast<uint32_t>(sizeof(bmpFileHeader)) + static_cast<uint32_t>(sizeof(bmpInfoHeader)) + imageSize, 0, sizeof(bmpFileHeader) + sizeof(bmpInfoHeader) };
+		bmpInfoHeader infoHeader{ sizeof(bmpInfoHeader), static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height), 1, bitCount, bmpCompression::BI_RGB, imageSize, 2835, 2835, 0, 0, 0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF, 0x57696E20 };
+
+		m_file.write(reinterpret_cast<char*>(&fileHeader), sizeof(bmpFileHeader));
+		m_file.write(reinterpret_cast<char*>(&infoHeader), sizeof(bmpInfoHeader));
+	}
+}
+
+void BmpWriter::writeRows(ConstBitmapView pixels, int32_t firstRow, int32_t count)
+{
+	if (pixels.width() != m_width || firstRow < 0 || count < 0 || firstRow + count > pixels.height() || count > rowsRemaining())
+		throw std::runtime_error("Rows out of range.");
+
+	// Iterating backwards because BMP pixel data starts from the bottom left corner of an image.
+	if (m_bitCount == 32)
+	{
+		for (int32_t y = firstRow + count - 1; y >= firstRow; y--)
+		{
+			m_file.write(
+				reinterpret_cast<const char*>(pixels.row(y)),
+				static_cast<std::streamsize>(sizeof(Color)) * static_cast<std::streamsize>(m_width)
+			);
+		}
+	}
+	else if (count > 0)
+	{
+		// Padding bytes are zeroed once when the buffer is allocated and never overwritten by the packed pixels.
+		const size_t rowSize = (static_cast<size_t>(m_width) * 3 + 3) & ~static_cast<size_t>(3);
+		const size_t chunkRows = std::max<size_t>(1, writeChunkSize / std::max<size_t>(1, rowSize));
+		const size_t stagingSize = std::min(chunkRows, static_cast<size_t>(count)) * rowSize;
+		if (m_staging.size() < stagingSize)
+			m_staging.resize(stagingSize);
+
+		int32_t y = firstRow + count - 1;
+		while (y >= firstRow)
+		{
+			const size_t rows = std::min(chunkRows, static_cast<size_t>(y - firstRow) + 1);
+			for (size_t i = 0; i < rows; i++, y--)
+				colorsToBgr(pixels.row(y), m_staging.data() + i * rowSize, m_width);
+			m_file.write(reinterpret_cast<const char*>(m_staging.data()), static_cast<std::streamsize>(rows * rowSize));
+		}
+	}
+
+	if (m_file.fail())
+		throw std::runtime_error("Couldn't write to file.");
+	m_rowsWritten += count;
+}
+
+void BmpWriter::writeBand(ConstBitmapView pixels, const BmpBand& band)
+{
+	if (band.top + band.rows != m_height - m_rowsWritten)
+		throw std::runtime_error("Bands have to be written in file order.");
+	writeRows(pixels, band.haloAbove, band.rows);
+}
+
+void filterBmpFile(const char* input, const char* output, int32_t bandHeight, int32_t haloRows, const std::function<void(Bitmap&)>& filter, uint16_t bitCount)
+{
+	BmpReader reader(input);
+	BmpWriter writer(output, reader.width(), reader.height(), bitCount);
+	reader.readBands(bandHeight, haloRows, [&](Bitmap& pixels, const BmpBand& band) {
+		filter(pixels);
+		writer.writeBand(pixels, band);
+	});
+}
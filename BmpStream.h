@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <vector>
+
+#include "Bitmap.h"
+#include "BmpHeaders.h"
+
+// Position of a band of rows inside of the full image. The bitmap that holds a band also contains haloAbove rows
+// before and haloBelow rows after the band, so neighbourhood filters see the same pixels as they would in the full image.
+struct BmpBand
+{
+	int32_t top;
+	int32_t rows;
+	int32_t haloAbove;
+	int32_t haloBelow;
+};
+
+// Reads the pixels of a BMP file a few rows at a time, so images bigger than the available memory can be processed.
+class BmpReader
+{
+public:
+	BmpReader(const char* filename);
+
+	int32_t width() const;
+	int32_t height() const;
+	// True if the pixels are stored exactly like Color and can be referenced directly from a memory mapping.
+	bool isMappable() const;
+	uint32_t pixelOffset() const;
+
+	// Reads the image rows [top, top + count) into the destination starting at destinationRow.
+	void readRows(int32_t top, int32_t count, BitmapView destination, int32_t destinationRow = 0);
+	Bitmap readRows(int32_t top, int32_t count);
+
+	// Calls the callback for consecutive bands of bandHeight rows in file order, which starts from the bottom of the image.
+	// Every band includes up to haloRows rows of the image above and below it. Only one band is kept in memory at a time.
+	void readBands(int32_t bandHeight, int32_t haloRows, const std::function<void(Bitmap& pixels, const BmpBand& band)>& callback);
+
+private:
+	std::ifstream m_file;
+	bmpFileHeader m_fileHeader;
+	bmpInfoHeader m_infoHeader;
+	int32_t m_width;
+	int32_t m_height;
+	size_t m_rowSize;
+};
+
+// Writes a BMP file in the format of Bitmap::saveToBmp from bands of rows.
+class BmpWriter
+{
+public:
+	BmpWriter(const char* filename, int32_t width, int32_t height, uint16_t bitCount = 32);
+
+	// Rows left to write. The file is incomplete until this reaches zero.
+	int32_t rowsRemaining() const;
+
+	// Writes the rows [firstRow, firstRow + count) of the pixels. The rows have to be given in file order - the first
+	// call writes the bottom of the image and every following call the rows directly above the previous ones.
+	void writeRows(ConstBitmapView pixels, int32_t firstRow, int32_t count);
+	void writeRows(ConstBitmapView pixels);
+	// Writes the band without its halo rows.
+	void writeBand(ConstBitmapView pixels, const BmpBand& band);
+
+private:
+	std::ofstream m_file;
+	int32_t m_width;
+	int32_t m_height;
+	uint16_t m_bitCount;
+	int32_t m_rowsWritten;
+	// 24 bit rows are packed here before writing. Kept between calls so writing bands doesn't reallocate it.
+	std::vector<uint8_t> m_staging;
+};
+
+// Runs the filter over the input file one band at a time and writes the result to the output file. The halo has to
+// cover the reach of the filter, for example the radius of a median filter or half of the height of a convolution matrix.
+void filterBmpFile(const char* input, const char* output, int32_t bandHeight, int32_t haloRows, const std::function<void(Bitmap&)>& filter, uint16_t bitCount = 32);
+
+inline int32_t BmpReader::width() const
+{
+	return m_width;
+}
+
+inline int32_t BmpReader::height() const
+{
+	return m_height;
+}
+
+inline uint32_t BmpReader::pixelOffset() const
+{
+	return m_fileHeader.offset;
+}
+
+inline int32_t BmpWriter::rowsRemaining() const
+{
+	return m_height - m_rowsWritten;
+}
+
+inline void BmpWriter::writeRows(ConstBitmapView pixels)
+{
+	writeRows(pixels, 0, pixels.height());
+}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Color.h"
+#include "HsvConversion.h"
 
 Color::Color()
 	:value(0)
@@ -133,9 +134,9 @@ Color Color::grayscale() const
 Color Color::lerp(const Color& color, float amount) const
 {
 	return Color(
-		static_cast<uint8_t>(static_cast<float>(r) + value * (static_cast<float>(color.r) - static_cast<float>(r)), 0.f, 255.f),
-		static_cast<uint8_t>(static_cast<float>(g) + value * (static_cast<float>(color.g) - static_cast<float>(b)), 0.f, 255.f),
-		static_cast<uint8_t>(static_cast<float>(b) + value * (static_cast<float>(color.b) - static_cast<float>(g)), 0.f, 255.f),
+		static_cast<uint8_t>(std::clamp(static_cast<float>(r) + amount * (static_cast<float>(color.r) - static_cast<float>(r)), 0.f, 255.f)),
+		static_cast<uint8_t>(std::clamp(static_cast<float>(g) + amount * (static_cast<float>(color.g) - static_cast<float>(g)), 0.f, 255.f)),
+		static_cast<uint8_t>(std::clamp(static_cast<float>(b) + amount * (static_cast<float>(color.b) - static_cast<float>(b)), 0.f, 255.f)),
 		a
 	);
 }
@@ -151,67 +152,14 @@ std::ostream& operator<< (std::ostream& os, const Color& color)
 
 Color hsvToRgb(const ColorHsv& color)
 {
-	float hue = color.h * 360.f;
-	/*if (hue > 360 || hue < 0 || color.s > 100 || color.s < 0 || color.v > 100 || color.v < 0) {
-		return Color();
-	}*/
-	float C = color.s * color.v;
-	float X = C * (1 - std::abs(std::fmod(hue / 60.0, 2) - 1));
-	float m = color.v - C;
-	float r, g, b;
-	if (hue >= 0 && hue < 60)
-		r = C, g = X, b = 0;
-	else if (hue >= 60 && hue < 120)
-		r = X, g = C, b = 0;
-	else if (hue >= 120 && hue < 180) 
-		r = 0, g = C, b = X;
-	else if (hue >= 180 && hue < 240) 
-		r = 0, g = X, b = C;
-	else if (hue >= 240 && hue < 300) 
-		r = X, g = 0, b = C;
-	else
-		r = C, g = 0, b = X;
-	int R = (r + m) * 255;
-	int G = (g + m) * 255;
-	int B = (b + m) * 255;
-	return Color(255 * (r + m), 255 * (g + m), 255 * (b + m));
+	Color result;
+	hsvToRgb(&color, &result, 1);
+	return result;
 }
 
 ColorHsv rgbToHsv(const Color& color)
 {
-	float cR = color.r / 255.0f;
-	float cG = color.g / 255.0f;
-	float cB = color.b / 255.0f;
-
-	float h, s, v; // h:0-360.0, s:0.0-1.0, v:0.0-1.0
-
-	float min = std::fminf(cR, fminf(cG, cB));
-	float max = std::fmaxf(cR, fmaxf(cG, cB));
-
-	v = max;
-
-	if (max == 0.0f)
-	{
-		s = 0;
-		h = 0;
-	}
-	else if (max - min == 0.0f)
-	{
-		s = 0;
-		h = 0;
-	}
-	else {
-		s = (max - min) / max;
-
-		if (max == cR)
-			h = 60 * ((cG - cB) / (max - min)) + 0;
-		else if (max == color.g)
-			h = 60 * ((cB - cR) / (max - min)) + 120;
-		else
-			h = 60 * ((cR - cG) / (max - min)) + 240;
-	}
-
-	if (h < 0) h += 360.0f;
-
-	return ColorHsv{ h / 360.0f, s, v };
+	ColorHsv result;
+	rgbToHsv(&color, &result, 1);
+	return result;
 }
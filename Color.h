@@ -43,6 +43,7 @@ public:
 	Color lerp(const Color& color, float amount) const;
 };
 
+// Hue, saturation and value in [0, 1].
 struct ColorHsv
 {
 	float h;
@@ -50,5 +51,6 @@ struct ColorHsv
 	float v;
 };
 
+// Single pixel versions of the conversions in HsvConversion.h.
 Color hsvToRgb(const ColorHsv& color);
 ColorHsv rgbToHsv(const Color& color);
\ No newline at end of file
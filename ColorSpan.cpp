@@ -0,0 +1,279 @@
+#include "ColorSpan.h"
+#include "intrinsics.h"
+
+// The scalar versions use the Color operators, the SIMD versions do the same integer or float operations in the same
+// order, so all of them give identical results. The float operations treat the four bytes of a pixel alike and the
+// alpha of the destination is put back afterwards.
+
+enum class SpanOperation
+{
+	Add,
+	Subtract,
+	Scale,
+	Invert,
+	Grayscale,
+	Lerp
+};
+
+// If constant is set the source is a single color used for every pixel. amount is the factor of Scale and Lerp.
+template <SpanOperation operation, bool constant>
+static void spanScalar(Color* destination, const Color* source, int32_t begin, int32_t end, float amount)
+{
+	for (int32_t x = begin; x < end; x++)
+	{
+		const Color& other = source[constant ? 0 : x];
+		switch (operation)
+		{
+		case SpanOperation::Add:
+			destination[x] += other;
+			break;
+		case SpanOperation::Subtract:
+			destination[x] -= other;
+			break;
+		case SpanOperation::Scale:
+			destination[x] *= amount;
+			break;
+		case SpanOperation::Invert:
+			destination[x] = destination[x].invert();
+			break;
+		case SpanOperation::Grayscale:
+			destination[x] = destination[x].grayscale();
+			break;
+		case SpanOperation::Lerp:
+			destination[x] = destination[x].lerp(other, amount);
+			break;
+		}
+	}
+}
+
+#ifdef BITMAP_X86
+
+// Mask of the red, green and blue bytes of every pixel.
+constexpr uint32_t colorMask = 0xFFFFFF00u;
+
+// Converts the 16 bytes to floats in an order that packFloatsSse41 reverses.
+TARGET_SSE41 static inline void unpackFloatsSse41(__m128i pixels, __m128 values[4])
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i low = _mm_unpacklo_epi8(pixels, zero);
+	const __m128i high = _mm_unpackhi_epi8(pixels, zero);
+	values[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+	values[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+	values[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+	values[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero));
+}
+
+// Clamps to [0, 255] and truncates like the conversion of the clamped float to uint8_t in the Color operators.
+TARGET_SSE41 static inline __m128i packFloatsSse41(const __m128 values[4])
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 max = _mm_set1_ps(255.f);
+	__m128i integers[4];
+	for (int i = 0; i < 4; i++)
+		integers[i] = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(values[i], zero), max));
+	return _mm_packus_epi16(_mm_packus_epi32(integers[0], integers[1]), _mm_packus_epi32(integers[2], integers[3]));
+}
+
+TARGET_SSE41 static inline __m128i grayscaleSse41(__m128i pixels)
+{
+	const __m128i byteMask = _mm_set1_epi32(0xFF);
+	const __m128 red = _mm_cvtepi32_ps(_mm_srli_epi32(pixels, 24));
+	const __m128 green = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), byteMask));
+	const __m128 blue = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), byteMask));
+	__m128 luma = _mm_add_ps(_mm_mul_ps(red, _mm_set1_ps(0.3f)), _mm_mul_ps(green, _mm_set1_ps(0.59f)));
+	luma = _mm_add_ps(luma, _mm_mul_ps(blue, _mm_set1_ps(0.11f)));
+	const __m128i value = _mm_cvttps_epi32(luma);
+	const __m128i gray = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(value, 24), _mm_slli_epi32(value, 16)), _mm_slli_epi32(value, 8));
+	return _mm_or_si128(gray, _mm_and_si128(pixels, byteMask));
+}
+
+template <SpanOperation operation, bool constant>
+TARGET_SSE41 static void spanSse41(Color* destination, const Color* source, int32_t begin, int32_t end, float amount)
+{
+	const __m128i colors = _mm_set1_epi32(static_cast<int>(colorMask));
+	const __m128 factor = _mm_set1_ps(amount);
+	const __m128i color = constant ? _mm_set1_epi32(static_cast<int>(source->value)) : _mm_setzero_si128();
+	int32_t x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + x));
+		const __m128i other = constant ? color : _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x));
+		__m128i result = pixels;
+		__m128 values[4], otherValues[4];
+		switch (operation)
+		{
+		case SpanOperation::Add:
+			result = _mm_adds_epu8(pixels, _mm_and_si128(other, colors));
+			break;
+		case SpanOperation::Subtract:
+			result = _mm_subs_epu8(pixels, _mm_and_si128(other, colors));
+			break;
+		case SpanOperation::Scale:
+			unpackFloatsSse41(pixels, values);
+			for (int i = 0; i < 4; i++)
+				values[i] = _mm_mul_ps(values[i], factor);
+			result = _mm_blendv_epi8(pixels, packFloatsSse41(values), colors);
+			break;
+		case SpanOperation::Invert:
+			result = _mm_xor_si128(pixels, colors);
+			break;
+		case SpanOperation::Grayscale:
+			result = grayscaleSse41(pixels);
+			break;
+		case SpanOperation::Lerp:
+			unpackFloatsSse41(pixels, values);
+			unpackFloatsSse41(other, otherValues);
+			for (int i = 0; i < 4; i++)
+				values[i] = _mm_add_ps(values[i], _mm_mul_ps(factor, _mm_sub_ps(otherValues[i], values[i])));
+			result = _mm_blendv_epi8(pixels, packFloatsSse41(values), colors);
+			break;
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x), result);
+	}
+	spanScalar<operation, constant>(destination, source, x, end, amount);
+}
+
+// Same as the SSE4.1 versions with both 128 bit lanes. The unpacking and packing stay inside of the lanes.
+TARGET_AVX2 static inline void unpackFloatsAvx2(__m256i pixels, __m256 values[4])
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i low = _mm256_unpacklo_epi8(pixels, zero);
+	const __m256i high = _mm256_unpackhi_epi8(pixels, zero);
+	values[0] = _mm256_cvtepi32_ps(_mm256_unpacklo_epi16(low, zero));
+	values[1] = _mm256_cvtepi32_ps(_mm256_unpackhi_epi16(low, zero));
+	values[2] = _mm256_cvtepi32_ps(_mm256_unpacklo_epi16(high, zero));
+	values[3] = _mm256_cvtepi32_ps(_mm256_unpackhi_epi16(high, zero));
+}
+
+TARGET_AVX2 static inline __m256i packFloatsAvx2(const __m256 values[4])
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 max = _mm256_set1_ps(255.f);
+	__m256i integers[4];
+	for (int i = 0; i < 4; i++)
+		integers[i] = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(values[i], zero), max));
+	return _mm256_packus_epi16(_mm256_packus_epi32(integers[0], integers[1]), _mm256_packus_epi32(integers[2], integers[3]));
+}
+
+TARGET_AVX2 static inline __m256i grayscaleAvx2(__m256i pixels)
+{
+	const __m256i byteMask = _mm256_set1_epi32(0xFF);
+	const __m256 red = _mm256_cvtepi32_ps(_mm256_srli_epi32(pixels, 24));
+	const __m256 green = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), byteMask));
+	const __m256 blue = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask));
+	__m256 luma = _mm256_add_ps(_mm256_mul_ps(red, _mm256_set1_ps(0.3f)), _mm256_mul_ps(green, _mm256_set1_ps(0.59f)));
+	luma = _mm256_add_ps(luma, _mm256_mul_ps(blue, _mm256_set1_ps(0.11f)));
+	const __m256i value = _mm256_cvttps_epi32(luma);
+	const __m256i gray = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(value, 24), _mm256_slli_epi32(value, 16)), _mm256_slli_epi32(value, 8));
+	return _mm256_or_si256(gray, _mm256_and_si256(pixels, byteMask));
+}
+
+template <SpanOperation operation, bool constant>
+TARGET_AVX2 static void spanAvx2(Color* destination, const Color* source, int32_t begin, int32_t end, float amount)
+{
+	const __m256i colors = _mm256_set1_epi32(static_cast<int>(colorMask));
+	const __m256 factor = _mm256_set1_ps(amount);
+	const __m256i color = constant ? _mm256_set1_epi32(static_cast<int>(source->value)) : _mm256_setzero_si256();
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destination + x));
+		const __m256i other = constant ? color : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + x));
+		__m256i result = pixels;
+		__m256 values[4], otherValues[4];
+		switch (operation)
+		{
+		case SpanOperation::Add:
+			result = _mm256_adds_epu8(pixels, _mm256_and_si256(other, colors));
+			break;
+		case SpanOperation::Subtract:
+			result = _mm256_subs_epu8(pixels, _mm256_and_si256(other, colors));
+			break;
+		case SpanOperation::Scale:
+			unpackFloatsAvx2(pixels, values);
+			for (int i = 0; i < 4; i++)
+				values[i] = _mm256_mul_ps(values[i], factor);
+			result = _mm256_blendv_epi8(pixels, packFloatsAvx2(values), colors);
+			break;
+		case SpanOperation::Invert:
+			result = _mm256_xor_si256(pixels, colors);
+			break;
+		case SpanOperation::Grayscale:
+			result = grayscaleAvx2(pixels);
+			break;
+		case SpanOperation::Lerp:
+			unpackFloatsAvx2(pixels, values);
+			unpackFloatsAvx2(other, otherValues);
+			for (int i = 0; i < 4; i++)
+				values[i] = _mm256_add_ps(values[i], _mm256_mul_ps(factor, _mm256_sub_ps(otherValues[i], values[i])));
+			result = _mm256_blendv_epi8(pixels, packFloatsAvx2(values), colors);
+			break;
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + x), result);
+	}
+	spanSse41<operation, constant>(destination, source, x, end, amount);
+}
+
+#endif
+
+template <SpanOperation operation, bool constant = false>
+static void span(Color* destination, const Color* source, int32_t count, float amount = 0)
+{
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		return spanAvx2<operation, constant>(destination, source, 0, count, amount);
+	case SimdLevel::Sse41:
+		return spanSse41<operation, constant>(destination, source, 0, count, amount);
+	default:
+		break;
+	}
+#endif
+	spanScalar<operation, constant>(destination, source, 0, count, amount);
+}
+
+void addSpan(Color* destination, const Color* source, int32_t count)
+{
+	span<SpanOperation::Add>(destination, source, count);
+}
+
+void addSpan(Color* destination, int32_t count, Color color)
+{
+	span<SpanOperation::Add, true>(destination, &color, count);
+}
+
+void subtractSpan(Color* destination, const Color* source, int32_t count)
+{
+	span<SpanOperation::Subtract>(destination, source, count);
+}
+
+void subtractSpan(Color* destination, int32_t count, Color color)
+{
+	span<SpanOperation::Subtract, true>(destination, &color, count);
+}
+
+void scaleSpan(Color* destination, int32_t count, float factor)
+{
+	span<SpanOperation::Scale, true>(destination, destination, count, factor);
+}
+
+void invertSpan(Color* destination, int32_t count)
+{
+	span<SpanOperation::Invert, true>(destination, destination, count);
+}
+
+void grayscaleSpan(Color* destination, int32_t count)
+{
+	span<SpanOperation::Grayscale, true>(destination, destination, count);
+}
+
+void lerpSpan(Color* destination, const Color* source, int32_t count, float amount)
+{
+	span<SpanOperation::Lerp>(destination, source, count, amount);
+}
+
+void lerpSpan(Color* destination, int32_t count, Color color, float amount)
+{
+	span<SpanOperation::Lerp, true>(destination, &color, count, amount);
+}
@@ -0,0 +1,477 @@
+#include "Convolution.h"
+#include "intrinsics.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// The filters work on separate red, green and blue float planes. Each output pixel is the sum of
+// weight * value over the kernel taps, accumulated in row-major tap order. All code paths use the same
+// order and no fused multiply-add so the vectorized and scalar results are bit identical.
+//
+// Only the columns closer to the left or right edge than half of the kernel width need clamping. Rows are
+// clamped once per output row when selecting the source row pointers, so the interior of every row is
+// processed without any bounds checks.
+
+struct ConvolutionTaps
+{
+	// kernelHeight row pointers for each channel - red rows first, then green, then blue.
+	const float* const* rows;
+	const float* weights;
+	int32_t kernelWidth;
+	int32_t kernelHeight;
+};
+
+static void accumulateScalar(const ConvolutionTaps& taps, int32_t begin, int32_t end, float* const out[3])
+{
+	const int32_t halfKernelWidth = taps.kernelWidth / 2;
+	for (int32_t x = begin; x < end; x++)
+	{
+		float color[3]{ 0 };
+		for (int32_t mY = 0; mY < taps.kernelHeight; mY++)
+		{
+			const float* red = taps.rows[mY] + x - halfKernelWidth;
+			const float* green = taps.rows[taps.kernelHeight + mY] + x - halfKernelWidth;
+			const float* blue = taps.rows[2 * taps.kernelHeight + mY] + x - halfKernelWidth;
+			const float* weights = taps.weights + mY * taps.kernelWidth;
+			for (int32_t mX = 0; mX < taps.kernelWidth; mX++)
+			{
+				color[0] += red[mX] * weights[mX];
+				color[1] += green[mX] * weights[mX];
+				color[2] += blue[mX] * weights[mX];
+			}
+		}
+		out[0][x] = color[0];
+		out[1][x] = color[1];
+		out[2][x] = color[2];
+	}
+}
+
+// Same as accumulateScalar but clamps the columns to [0, width - 1]. Used for the left and right border strips.
+static void accumulateClamped(const ConvolutionTaps& taps, int32_t begin, int32_t end, int32_t width, float* const out[3])
+{
+	const int32_t halfKernelWidth = taps.kernelWidth / 2;
+	for (int32_t x = begin; x < end; x++)
+	{
+		float color[3]{ 0 };
+		for (int32_t mY = 0; mY < taps.kernelHeight; mY++)
+		{
+			const float* red = taps.rows[mY];
+			const float* green = taps.rows[taps.kernelHeight + mY];
+			const float* blue = taps.rows[2 * taps.kernelHeight + mY];
+			const float* weights = taps.weights + mY * taps.kernelWidth;
+			for (int32_t mX = 0; mX < taps.kernelWidth; mX++)
+			{
+				const int32_t column = std::clamp(x + mX - halfKernelWidth, 0, width - 1);
+				color[0] += red[column] * weights[mX];
+				color[1] += green[column] * weights[mX];
+				color[2] += blue[column] * weights[mX];
+			}
+		}
+		out[0][x] = color[0];
+		out[1][x] = color[1];
+		out[2][x] = color[2];
+	}
+}
+
+static void toPlanesScalar(const Color* colors, int32_t begin, int32_t end, float* const out[3])
+{
+	for (int32_t x = begin; x < end; x++)
+	{
+		out[0][x] = colors[x].r;
+		out[1][x] = colors[x].g;
+		out[2][x] = colors[x].b;
+	}
+}
+
+static void fromPlanesScalar(const float* const in[3], int32_t begin, int32_t end, Color* colors)
+{
+	for (int32_t x = begin; x < end; x++)
+	{
+		colors[x] = Color(
+			static_cast<uint8_t>(std::clamp(in[0][x], 0.f, 255.f)),
+			static_cast<uint8_t>(std::clamp(in[1][x], 0.f, 255.f)),
+			static_cast<uint8_t>(std::clamp(in[2][x], 0.f, 255.f))
+		);
+	}
+}
+
+#ifdef BITMAP_X86
+
+TARGET_SSE41 static void accumulateSse41(const ConvolutionTaps& taps, int32_t begin, int32_t end, float* const out[3])
+{
+	const int32_t halfKernelWidth = taps.kernelWidth / 2;
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		__m128 red0 = _mm_setzero_ps(), red1 = _mm_setzero_ps();
+		__m128 green0 = _mm_setzero_ps(), green1 = _mm_setzero_ps();
+		__m128 blue0 = _mm_setzero_ps(), blue1 = _mm_setzero_ps();
+		for (int32_t mY = 0; mY < taps.kernelHeight; mY++)
+		{
+			const float* red = taps.rows[mY] + x - halfKernelWidth;
+			const float* green = taps.rows[taps.kernelHeight + mY] + x - halfKernelWidth;
+			const float* blue = taps.rows[2 * taps.kernelHeight + mY] + x - halfKernelWidth;
+			const float* weights = taps.weights + mY * taps.kernelWidth;
+			for (int32_t mX = 0; mX < taps.kernelWidth; mX++)
+			{
+				const __m128 weight = _mm_set1_ps(weights[mX]);
+				red0 = _mm_add_ps(red0, _mm_mul_ps(_mm_loadu_ps(red + mX), weight));
+				red1 = _mm_add_ps(red1, _mm_mul_ps(_mm_loadu_ps(red + mX + 4), weight));
+				green0 = _mm_add_ps(green0, _mm_mul_ps(_mm_loadu_ps(green + mX), weight));
+				green1 = _mm_add_ps(green1, _mm_mul_ps(_mm_loadu_ps(green + mX + 4), weight));
+				blue0 = _mm_add_ps(blue0, _mm_mul_ps(_mm_loadu_ps(blue + mX), weight));
+				blue1 = _mm_add_ps(blue1, _mm_mul_ps(_mm_loadu_ps(blue + mX + 4), weight));
+			}
+		}
+		_mm_storeu_ps(out[0] + x, red0);
+		_mm_storeu_ps(out[0] + x + 4, red1);
+		_mm_storeu_ps(out[1] + x, green0);
+		_mm_storeu_ps(out[1] + x + 4, green1);
+		_mm_storeu_ps(out[2] + x, blue0);
+		_mm_storeu_ps(out[2] + x + 4, blue1);
+	}
+	accumulateScalar(taps, x, end, out);
+}
+
+TARGET_AVX2 static void accumulateAvx2(const ConvolutionTaps& taps, int32_t begin, int32_t end, float* const out[3])
+{
+	const int32_t halfKernelWidth = taps.kernelWidth / 2;
+	int32_t x = begin;
+	for (; x + 16 <= end; x += 16)
+	{
+		__m256 red0 = _mm256_setzero_ps(), red1 = _mm256_setzero_ps();
+		__m256 green0 = _mm256_setzero_ps(), green1 = _mm256_setzero_ps();
+		__m256 blue0 = _mm256_setzero_ps(), blue1 = _mm256_setzero_ps();
+		for (int32_t mY = 0; mY < taps.kernelHeight; mY++)
+		{
+			const float* red = taps.rows[mY] + x - halfKernelWidth;
+			const float* green = taps.rows[taps.kernelHeight + mY] + x - halfKernelWidth;
+			const float* blue = taps.rows[2 * taps.kernelHeight + mY] + x - halfKernelWidth;
+			const float* weights = taps.weights + mY * taps.kernelWidth;
+			for (int32_t mX = 0; mX < taps.kernelWidth; mX++)
+			{
+				const __m256 weight = _mm256_set1_ps(weights[mX]);
+				red0 = _mm256_add_ps(red0, _mm256_mul_ps(_mm256_loadu_ps(red + mX), weight));
+				red1 = _mm256_add_ps(red1, _mm256_mul_ps(_mm256_loadu_ps(red + mX + 8), weight));
+				green0 = _mm256_add_ps(green0, _mm256_mul_ps(_mm256_loadu_ps(green + mX), weight));
+				green1 = _mm256_add_ps(green1, _mm256_mul_ps(_mm256_loadu_ps(green + mX + 8), weight));
+				blue0 = _mm256_add_ps(blue0, _mm256_mul_ps(_mm256_loadu_ps(blue + mX), weight));
+				blue1 = _mm256_add_ps(blue1, _mm256_mul_ps(_mm256_loadu_ps(blue + mX + 8), weight));
+			}
+		}
+		_mm256_storeu_ps(out[0] + x, red0);
+		_mm256_storeu_ps(out[0] + x + 8, red1);
+		_mm256_storeu_ps(out[1] + x, green0);
+		_mm256_storeu_ps(out[1] + x + 8, green1);
+		_mm256_storeu_ps(out[2] + x, blue0);
+		_mm256_storeu_ps(out[2] + x + 8, blue1);
+	}
+	accumulateSse41(taps, x, end, out);
+}
+
+TARGET_SSE41 static void toPlanesSse41(const Color* colors, int32_t begin, int32_t end, float* const out[3])
+{
+	const __m128i byteMask = _mm_set1_epi32(0xFF);
+	int32_t x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + x));
+		_mm_storeu_ps(out[0] + x, _mm_cvtepi32_ps(_mm_srli_epi32(pixels, 24)));
+		_mm_storeu_ps(out[1] + x, _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), byteMask)));
+		_mm_storeu_ps(out[2] + x, _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), byteMask)));
+	}
+	toPlanesScalar(colors, x, end, out);
+}
+
+TARGET_AVX2 static void toPlanesAvx2(const Color* colors, int32_t begin, int32_t end, float* const out[3])
+{
+	const __m256i byteMask = _mm256_set1_epi32(0xFF);
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(colors + x));
+		_mm256_storeu_ps(out[0] + x, _mm256_cvtepi32_ps(_mm256_srli_epi32(pixels, 24)));
+		_mm256_storeu_ps(out[1] + x, _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), byteMask)));
+		_mm256_storeu_ps(out[2] + x, _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask)));
+	}
+	toPlanesSse41(colors, x, end, out);
+}
+
+TARGET_SSE41 static void fromPlanesSse41(const float* const in[3], int32_t begin, int32_t end, Color* colors)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 max = _mm_set1_ps(255.f);
+	const __m128i alpha = _mm_set1_epi32(0xFF);
+	int32_t x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		const __m128i red = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in[0] + x), zero), max));
+		const __m128i green = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in[1] + x), zero), max));
+		const __m128i blue = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in[2] + x), zero), max));
+		const __m128i pixels = _mm_or_si128(
+			_mm_or_si128(_mm_slli_epi32(red, 24), _mm_slli_epi32(green, 16)),
+			_mm_or_si128(_mm_slli_epi32(blue, 8), alpha)
+		);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(colors + x), pixels);
+	}
+	fromPlanesScalar(in, x, end, colors);
+}
+
+TARGET_AVX2 static void fromPlanesAvx2(const float* const in[3], int32_t begin, int32_t end, Color* colors)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 max = _mm256_set1_ps(255.f);
+	const __m256i alpha = _mm256_set1_epi32(0xFF);
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		const __m256i red = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in[0] + x), zero), max));
+		const __m256i green = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in[1] + x), zero), max));
+		const __m256i blue = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in[2] + x), zero), max));
+		const __m256i pixels = _mm256_or_si256(
+			_mm256_or_si256(_mm256_slli_epi32(red, 24), _mm256_slli_epi32(green, 16)),
+			_mm256_or_si256(_mm256_slli_epi32(blue, 8), alpha)
+		);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(colors + x), pixels);
+	}
+	fromPlanesSse41(in, x, end, colors);
+}
+
+#endif
+
+struct ConvolutionKernels
+{
+	void (*accumulate)(const ConvolutionTaps& taps, int32_t begin, int32_t end, float* const out[3]);
+	void (*toPlanes)(const Color* colors, int32_t begin, int32_t end, float* const out[3]);
+	void (*fromPlanes)(const float* const in[3], int32_t begin, int32_t end, Color* colors);
+};
+
+static ConvolutionKernels selectKernels()
+{
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		return { accumulateAvx2, toPlanesAvx2, fromPlanesAvx2 };
+	case SimdLevel::Sse41:
+		return { accumulateSse41, toPlanesSse41, fromPlanesSse41 };
+	default:
+		break;
+	}
+#endif
+	return { accumulateScalar, toPlanesScalar, fromPlanesScalar };
+}
+
+// Computes one row of output. The rows of the taps have to be set up by the caller.
+// Only the interior, where no tap reaches past the edge of the row, is vectorized.
+static void convolveRow(const ConvolutionKernels& kernels, const ConvolutionTaps& taps, int32_t width, float* const out[3])
+{
+	const int32_t halfKernelWidth = taps.kernelWidth / 2;
+	const int32_t interiorBegin = std::min(halfKernelWidth, width);
+	const int32_t interiorEnd = std::max(interiorBegin, width - halfKernelWidth);
+
+	accumulateClamped(taps, 0, interiorBegin, width, out);
+	kernels.accumulate(taps, interiorBegin, interiorEnd, out);
+	accumulateClamped(taps, interiorEnd, width, width, out);
+}
+
+static Buffer<float> matrixWeights(const Matrix& matrix, const BufferAllocator<float>& allocator)
+{
+	const int32_t matWidth = static_cast<int32_t>(matrix.width());
+	const int32_t matHeight = static_cast<int32_t>(matrix.height());
+	Buffer<float> weights(matrix.width() * matrix.height(), allocator);
+	for (int32_t mY = 0; mY < matHeight; mY++)
+	{
+		for (int32_t mX = 0; mX < matWidth; mX++)
+			weights[mY * matWidth + mX] = matrix.get(mX, mY);
+	}
+	return weights;
+}
+
+static void checkSizes(const FloatImage& source, const FloatImage& destination)
+{
+	if (source.width() != destination.width() || source.height() != destination.height())
+		throw std::runtime_error("Image sizes don't match.");
+	if (&source == &destination)
+		throw std::runtime_error("Source and destination are the same image.");
+}
+
+static void copyAlpha(const FloatImage& source, FloatImage& destination, int32_t y)
+{
+	memcpy(destination.row(FloatImage::Alpha, y), source.row(FloatImage::Alpha, y), sizeof(float) * source.width());
+}
+
+void convolve(ConstBitmapView source, BitmapView destination, const Matrix& matrix, ThreadPool* pool)
+{
+	if (destination.width() != source.width() || destination.height() != source.height())
+		throw std::runtime_error("Bitmap sizes don't match.");
+	const ConvolutionKernels kernels = selectKernels();
+	const int32_t width = source.width();
+	const int32_t height = source.height();
+	const int32_t matWidth = static_cast<int32_t>(matrix.width());
+	const int32_t matHeight = static_cast<int32_t>(matrix.height());
+	const int32_t halfMatHeight = matHeight / 2;
+	const size_t planeSize = static_cast<size_t>(width) * static_cast<size_t>(height);
+
+	const BufferAllocator<float> scratch(destination.allocator());
+	Buffer<float> planes(planeSize * 3, scratch);
+	float* const sourcePlanes[3] = { planes.data(), planes.data() + planeSize, planes.data() + 2 * planeSize };
+	parallelFor(pool, 0, height, 0, [&](int32_t firstRow, int32_t lastRow) {
+		for (int32_t y = firstRow; y < lastRow; y++)
+		{
+			float* const rowPlanes[3] = { sourcePlanes[0] + y * width, sourcePlanes[1] + y * width, sourcePlanes[2] + y * width };
+			kernels.toPlanes(&source.getPixel(0, y), 0, width, rowPlanes);
+		}
+	});
+
+	const Buffer<float> weights = matrixWeights(matrix, scratch);
+
+	parallelFor(pool, 0, height, 0, [&](int32_t firstRow, int32_t lastRow) {
+		Buffer<float> output(static_cast<size_t>(width) * 3, scratch);
+		float* const outputPlanes[3] = { output.data(), output.data() + width, output.data() + 2 * width };
+
+		Buffer<const float*> rows(static_cast<size_t>(matHeight) * 3, scratch);
+		const ConvolutionTaps taps{ rows.data(), weights.data(), matWidth, matHeight };
+		for (int32_t y = firstRow; y < lastRow; y++)
+		{
+			for (int32_t mY = 0; mY < matHeight; mY++)
+			{
+				const size_t rowStart = static_cast<size_t>(std::clamp(y + mY - halfMatHeight, 0, height - 1)) * width;
+				for (int32_t channel = 0; channel < 3; channel++)
+					rows[channel * matHeight + mY] = sourcePlanes[channel] + rowStart;
+			}
+			convolveRow(kernels, taps, width, outputPlanes);
+			kernels.fromPlanes(outputPlanes, 0, width, &destination.getPixel(0, y));
+		}
+	});
+}
+
+void convolveSeparable(ConstBitmapView source, BitmapView destination, const std::vector<float>& horizontal, const std::vector<float>& vertical, ThreadPool* pool)
+{
+	if (destination.width() != source.width() || destination.height() != source.height())
+		throw std::runtime_error("Bitmap sizes don't match.");
+	const ConvolutionKernels kernels = selectKernels();
+	const int32_t width = source.width();
+	const int32_t height = source.height();
+	const int32_t horizontalSize = static_cast<int32_t>(horizontal.size());
+	const int32_t verticalSize = static_cast<int32_t>(vertical.size());
+	const int32_t halfVertical = verticalSize / 2;
+	const size_t planeSize = static_cast<size_t>(width) * static_cast<size_t>(height);
+
+	const BufferAllocator<float> scratch(destination.allocator());
+	Buffer<float> planes(planeSize * 3, scratch);
+	float* const intermediate[3] = { planes.data(), planes.data() + planeSize, planes.data() + 2 * planeSize };
+
+	parallelFor(pool, 0, height, 0, [&](int32_t firstRow, int32_t lastRow) {
+		Buffer<float> row(static_cast<size_t>(width) * 3, scratch);
+		float* const rowPlanes[3] = { row.data(), row.data() + width, row.data() + 2 * width };
+
+		const float* horizontalRows[3] = { rowPlanes[0], rowPlanes[1], rowPlanes[2] };
+		const ConvolutionTaps horizontalTaps{ horizontalRows, horizontal.data(), horizontalSize, 1 };
+		for (int32_t y = firstRow; y < lastRow; y++)
+		{
+			float* const out[3] = { intermediate[0] + y * width, intermediate[1] + y * width, intermediate[2] + y * width };
+			kernels.toPlanes(&source.getPixel(0, y), 0, width, rowPlanes);
+			convolveRow(kernels, horizontalTaps, width, out);
+		}
+	});
+
+	// The vertical pass needs the neighbouring rows of the intermediate result, so it can only start after all bands
+	// of the horizontal pass are done.
+	parallelFor(pool, 0, height, 0, [&](int32_t firstRow, int32_t lastRow) {
+		Buffer<float> row(static_cast<size_t>(width) * 3, scratch);
+		float* const rowPlanes[3] = { row.data(), row.data() + width, row.data() + 2 * width };
+
+		Buffer<const float*> verticalRows(static_cast<size_t>(verticalSize) * 3, scratch);
+		const ConvolutionTaps verticalTaps{ verticalRows.data(), vertical.data(), 1, verticalSize };
+		for (int32_t y = firstRow; y < lastRow; y++)
+		{
+			for (int32_t k = 0; k < verticalSize; k++)
+			{
+				const size_t rowStart = static_cast<size_t>(std::clamp(y + k - halfVertical, 0, height - 1)) * width;
+				for (int32_t channel = 0; channel < 3; channel++)
+					verticalRows[channel * verticalSize + k] = intermediate[channel] + rowStart;
+			}
+			convolveRow(kernels, verticalTaps, width, rowPlanes);
+			kernels.fromPlanes(rowPlanes, 0, width, &destination.getPixel(0, y));
+		}
+	});
+}
+
+void convolve(const FloatImage& source, FloatImage& destination, const Matrix& matrix, ThreadPool* pool)
+{
+	checkSizes(source, destination);
+	if (!(matrix.width() & 1 && matrix.height() & 1))
+		throw std::runtime_error("Matrix width and height must be an odd number.");
+	const ConvolutionKernels kernels = selectKernels();
+	const int32_t width = source.width();
+	const int32_t height = source.height();
+	const int32_t matWidth = static_cast<int32_t>(matrix.width());
+	const int32_t matHeight = static_cast<int32_t>(matrix.height());
+	const int32_t halfMatHeight = matHeight / 2;
+
+	const BufferAllocator<float> scratch(destination.allocator());
+	const Buffer<float> weights = matrixWeights(matrix, scratch);
+
+	parallelFor(pool, 0, height, 0, [&](int32_t firstRow, int32_t lastRow) {
+		Buffer<const float*> rows(static_cast<size_t>(matHeight) * 3, scratch);
+		const ConvolutionTaps taps{ rows.data(), weights.data(), matWidth, matHeight };
+		for (int32_t y = firstRow; y < lastRow; y++)
+		{
+			for (int32_t mY = 0; mY < matHeight; mY++)
+			{
+				const int32_t sourceRow = std::clamp(y + mY - halfMatHeight, 0, height - 1);
+				for (int32_t channel = 0; channel < 3; channel++)
+					rows[channel * matHeight + mY] = source.row(channel, sourceRow);
+			}
+			float* const out[3] = { destination.row(FloatImage::Red, y), destination.row(FloatImage::Green, y), destination.row(FloatImage::Blue, y) };
+			convolveRow(kernels, taps, width, out);
+			copyAlpha(source, destination, y);
+		}
+	});
+}
+
+void convolveSeparable(const FloatImage& source, FloatImage& destination, const std::vector<float>& horizontal, const std::vector<float>& vertical, ThreadPool* pool)
+{
+	checkSizes(source, destination);
+	if (!(horizontal.size() & 1 && vertical.size() & 1))
+		throw std::runtime_error("Kernel sizes must be odd numbers.");
+	const ConvolutionKernels kernels = selectKernels();
+	const int32_t width = source.width();
+	const int32_t height = source.height();
+	const int32_t horizontalSize = static_cast<int32_t>(horizontal.size());
+	const int32_t verticalSize = static_cast<int32_t>(vertical.size());
+	const int32_t halfVertical = verticalSize / 2;
+	const size_t planeSize = static_cast<size_t>(width) * static_cast<size_t>(height);
+
+	const BufferAllocator<float> scratch(destination.allocator());
+	Buffer<float> planes(planeSize * 3, scratch);
+	float* const intermediate[3] = { planes.data(), planes.data() + planeSize, planes.data() + 2 * planeSize };
+
+	parallelFor(pool, 0, height, 0, [&](int32_t firstRow, int32_t lastRow) {
+		for (int32_t y = firstRow; y < lastRow; y++)
+		{
+			const float* horizontalRows[3] = { source.row(FloatImage::Red, y), source.row(FloatImage::Green, y), source.row(FloatImage::Blue, y) };
+			const ConvolutionTaps horizontalTaps{ horizontalRows, horizontal.data(), horizontalSize, 1 };
+			float* const out[3] = { intermediate[0] + y * width, intermediate[1] + y * width, intermediate[2] + y * width };
+			convolveRow(kernels, horizontalTaps, width, out);
+		}
+	});
+
+	parallelFor(pool, 0, height, 0, [&](int32_t firstRow, int32_t lastRow) {
+		Buffer<const float*> verticalRows(static_cast<size_t>(verticalSize) * 3, scratch);
+		const ConvolutionTaps verticalTaps{ verticalRows.data(), vertical.data(), 1, verticalSize };
+		for (int32_t y = firstRow; y < lastRow; y++)
+		{
+			for (int32_t k = 0; k < verticalSize; k++)
+			{
+				const size_t rowStart = static_cast<size_t>(std::clamp(y + k - halfVertical, 0, height - 1)) * width;
+				for (int32_t channel = 0; channel < 3; channel++)
+					verticalRows[channel * verticalSize + k] = intermediate[channel] + rowStart;
+			}
+			float* const out[3] = { destination.row(FloatImage::Red, y), destination.row(FloatImage::Green, y), destination.row(FloatImage::Blue, y) };
+			convolveRow(kernels, verticalTaps, width, out);
+			copyAlpha(source, destination, y);
+		}
+	});
+}
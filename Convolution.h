@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Bitmap.h"
+#include "FloatImage.h"
+#include "Matrix.h"
+#include "ThreadPool.h"
+
+// Both functions treat pixels outside of the source as copies of the nearest edge pixel and write
+// opaque colors to the destination, which has to be the same size as the source.
+// With a pool the rows are processed in bands on multiple threads. Every output pixel is computed the same way
+// regardless of how the rows are split, so the result is identical to the single threaded one.
+
+void convolve(ConstBitmapView source, BitmapView destination, const Matrix& matrix, ThreadPool* pool = nullptr);
+
+// Runs the horizontal kernel over the rows into a float buffer and then the vertical kernel over its columns.
+// The result is equal to convolving with the outer product of the kernels.
+void convolveSeparable(ConstBitmapView source, BitmapView destination, const std::vector<float>& horizontal, const std::vector<float>& vertical, ThreadPool* pool = nullptr);
+
+// Same filters for float images. Red, green and blue are filtered and stored without clamping or rounding, alpha is
+// copied unchanged. The destination has to be a different image of the same size and the kernels need odd sizes.
+void convolve(const FloatImage& source, FloatImage& destination, const Matrix& matrix, ThreadPool* pool = nullptr);
+void convolveSeparable(const FloatImage& source, FloatImage& destination, const std::vector<float>& horizontal, const std::vector<float>& vertical, ThreadPool* pool = nullptr);
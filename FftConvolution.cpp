@@ -0,0 +1,314 @@
+#include "FftConvolution.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+
+// Overlap-save: every tile of the image is transformed, multiplied with the transform of the kernel and transformed
+// back, which gives the circular convolution of the tile. Only the part of it where the kernel didn't wrap around the
+// tile is kept, so neighbouring tiles overlap by the size of the kernel minus one.
+// The kernel is flipped and centered on the origin of the tile so the product gives the same weighting as convolve.
+
+using Complex = std::complex<double>;
+
+// Tiles are at least this many times larger than the kernel so most of every tile is kept.
+static constexpr int32_t tileToKernelRatio = 8;
+static constexpr int32_t minTileSize = 64;
+
+// Added before truncating the results to integers so values that are integers up to the rounding of the transforms,
+// for example a flat area, don't end up one lower than with the direct convolution.
+static constexpr double roundingBias = 1e-6;
+
+static Complex multiply(Complex a, Complex b)
+{
+	// Written out because operator* of std::complex handles infinities and NaNs, which makes it a lot slower.
+	return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+static void reverseRows(Complex* tile, int32_t size)
+{
+	for (int32_t i = 1, j = 0; i < size; i++)
+	{
+		int32_t bit = size >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j)
+			std::swap_ranges(tile + static_cast<size_t>(i) * size, tile + static_cast<size_t>(i + 1) * size, tile + static_cast<size_t>(j) * size);
+	}
+}
+
+// In-place iterative radix-2 transform of every column of a square tile. The butterflies combine whole rows, so all
+// memory accesses are contiguous and the inner loop runs over the columns. The inverse transform isn't scaled.
+static void fftColumnsScalar(Complex* tile, int32_t size, const std::vector<Complex>& twiddles)
+{
+	reverseRows(tile, size);
+	for (int32_t length = 2; length <= size; length <<= 1)
+	{
+		const int32_t half = length / 2;
+		const int32_t twiddleStep = size / length;
+		for (int32_t start = 0; start < size; start += length)
+		{
+			for (int32_t k = 0; k < half; k++)
+			{
+				const Complex twiddle = twiddles[k * twiddleStep];
+				Complex* even = tile + static_cast<size_t>(start + k) * size;
+				Complex* odd = even + static_cast<size_t>(half) * size;
+				for (int32_t x = 0; x < size; x++)
+				{
+					const Complex product = multiply(odd[x], twiddle);
+					odd[x] = even[x] - product;
+					even[x] += product;
+				}
+			}
+		}
+	}
+}
+
+static void multiplySpectrumScalar(Complex* tile, const Complex* spectrum, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		tile[i] = multiply(tile[i], spectrum[i]);
+}
+
+#ifdef BITMAP_X86
+
+// Two complex numbers per register. addsub gives the same results as multiply because the real part is computed
+// with the same operations and the terms of the imaginary part are only swapped.
+TARGET_AVX2 static inline __m256d multiplyAvx2(__m256d a, __m256d bReal, __m256d bImaginary)
+{
+	return _mm256_addsub_pd(_mm256_mul_pd(a, bReal), _mm256_mul_pd(_mm256_permute_pd(a, 0x5), bImaginary));
+}
+
+// The tiles are at least minTileSize wide, so the rows always hold an even number of complex numbers.
+TARGET_AVX2 static void fftColumnsAvx2(Complex* tile, int32_t size, const std::vector<Complex>& twiddles)
+{
+	reverseRows(tile, size);
+	for (int32_t length = 2; length <= size; length <<= 1)
+	{
+		const int32_t half = length / 2;
+		const int32_t twiddleStep = size / length;
+		for (int32_t start = 0; start < size; start += length)
+		{
+			for (int32_t k = 0; k < half; k++)
+			{
+				const __m256d twiddleReal = _mm256_set1_pd(twiddles[k * twiddleStep].real());
+				const __m256d twiddleImaginary = _mm256_set1_pd(twiddles[k * twiddleStep].imag());
+				double* even = reinterpret_cast<double*>(tile + static_cast<size_t>(start + k) * size);
+				double* odd = even + 2 * static_cast<size_t>(half) * size;
+				for (int32_t x = 0; x < 2 * size; x += 4)
+				{
+					const __m256d product = multiplyAvx2(_mm256_loadu_pd(odd + x), twiddleReal, twiddleImaginary);
+					const __m256d evenValue = _mm256_loadu_pd(even + x);
+					_mm256_storeu_pd(odd + x, _mm256_sub_pd(evenValue, product));
+					_mm256_storeu_pd(even + x, _mm256_add_pd(evenValue, product));
+				}
+			}
+		}
+	}
+}
+
+TARGET_AVX2 static void multiplySpectrumAvx2(Complex* tile, const Complex* spectrum, size_t count)
+{
+	double* values = reinterpret_cast<double*>(tile);
+	const double* factors = reinterpret_cast<const double*>(spectrum);
+	for (size_t i = 0; i < 2 * count; i += 4)
+	{
+		const __m256d factor = _mm256_loadu_pd(factors + i);
+		_mm256_storeu_pd(values + i, multiplyAvx2(_mm256_loadu_pd(values + i), _mm256_movedup_pd(factor), _mm256_permute_pd(factor, 0xF)));
+	}
+}
+
+#endif
+
+struct FftKernels
+{
+	void (*fftColumns)(Complex* tile, int32_t size, const std::vector<Complex>& twiddles);
+	void (*multiplySpectrum)(Complex* tile, const Complex* spectrum, size_t count);
+};
+
+static FftKernels selectKernels()
+{
+#ifdef BITMAP_X86
+	if (simdLevel() == SimdLevel::Avx2)
+		return { fftColumnsAvx2, multiplySpectrumAvx2 };
+#endif
+	return { fftColumnsScalar, multiplySpectrumScalar };
+}
+
+static void transpose(Complex* tile, int32_t size)
+{
+	for (int32_t y = 0; y < size; y++)
+	{
+		for (int32_t x = y + 1; x < size; x++)
+			std::swap(tile[static_cast<size_t>(y) * size + x], tile[static_cast<size_t>(x) * size + y]);
+	}
+}
+
+// Transforms the columns, then the rows by transposing and transforming the columns again. The result is transposed,
+// which doesn't matter as long as the image and the kernel are transformed the same way: the inverse of a transposed
+// spectrum is transformed back into the original orientation.
+static void fft2d(const FftKernels& kernels, Complex* tile, int32_t size, const std::vector<Complex>& twiddles)
+{
+	kernels.fftColumns(tile, size, twiddles);
+	transpose(tile, size);
+	kernels.fftColumns(tile, size, twiddles);
+}
+
+FftKernel::FftKernel(const Matrix& matrix)
+	:m_kernelWidth(static_cast<int32_t>(matrix.width()))
+	, m_kernelHeight(static_cast<int32_t>(matrix.height()))
+	, m_tileSize(minTileSize)
+{
+	if (!(m_kernelWidth & 1 && m_kernelHeight & 1))
+		throw std::runtime_error("Matrix width and height must be an odd number.");
+
+	while (m_tileSize < tileToKernelRatio * std::max(m_kernelWidth, m_kernelHeight))
+		m_tileSize *= 2;
+
+	m_weights.resize(matrix.width() * matrix.height());
+	for (int32_t y = 0; y < m_kernelHeight; y++)
+	{
+		for (int32_t x = 0; x < m_kernelWidth; x++)
+			m_weights[y * m_kernelWidth + x] = matrix.get(x, y);
+	}
+
+	const double pi = std::acos(-1.0);
+	m_twiddles.resize(m_tileSize / 2);
+	m_inverseTwiddles.resize(m_tileSize / 2);
+	for (int32_t k = 0; k < m_tileSize / 2; k++)
+	{
+		m_twiddles[k] = std::polar(1.0, -2 * pi * k / m_tileSize);
+		m_inverseTwiddles[k] = std::conj(m_twiddles[k]);
+	}
+
+	// Weight (x, y) goes to (halfWidth - x, halfHeight - y), wrapped around the tile.
+	const size_t tileArea = static_cast<size_t>(m_tileSize) * m_tileSize;
+	m_spectrum.assign(tileArea, Complex(0, 0));
+	for (int32_t y = 0; y < m_kernelHeight; y++)
+	{
+		for (int32_t x = 0; x < m_kernelWidth; x++)
+		{
+			const int32_t tileX = (m_kernelWidth / 2 - x + m_tileSize) % m_tileSize;
+			const int32_t tileY = (m_kernelHeight / 2 - y + m_tileSize) % m_tileSize;
+			m_spectrum[static_cast<size_t>(tileY) * m_tileSize + tileX] = Complex(m_weights[y * m_kernelWidth + x] / static_cast<double>(tileArea), 0);
+		}
+	}
+
+	fft2d(selectKernels(), m_spectrum.data(), m_tileSize, m_twiddles);
+}
+
+std::shared_ptr<const FftKernel> FftKernel::cached(const Matrix& matrix)
+{
+	static std::mutex mutex;
+	static std::shared_ptr<const FftKernel> last;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (last && last->m_kernelWidth == static_cast<int32_t>(matrix.width()) && last->m_kernelHeight == static_cast<int32_t>(matrix.height()))
+	{
+		bool same = true;
+		for (int32_t y = 0; y < last->m_kernelHeight && same; y++)
+		{
+			for (int32_t x = 0; x < last->m_kernelWidth && same; x++)
+				same = last->m_weights[y * last->m_kernelWidth + x] == matrix.get(x, y);
+		}
+		if (same)
+			return last;
+	}
+
+	last = std::make_shared<const FftKernel>(matrix);
+	return last;
+}
+
+static uint8_t toChannel(double value)
+{
+	return static_cast<uint8_t>(std::clamp(value + roundingBias, 0.0, 255.0));
+}
+
+void convolveFft(ConstBitmapView source, BitmapView destination, const FftKernel& kernel, ThreadPool* pool)
+{
+	const int32_t width = source.width();
+	const int32_t height = source.height();
+	if (destination.width() != width || destination.height() != height)
+		throw std::runtime_error("Bitmap sizes don't match.");
+	if (width == 0 || height == 0)
+		return;
+
+	const int32_t tileSize = kernel.tileSize();
+	const int32_t halfWidth = kernel.kernelWidth() / 2;
+	const int32_t halfHeight = kernel.kernelHeight() / 2;
+	// Size of the part of every tile that is kept.
+	const int32_t validWidth = tileSize - kernel.kernelWidth() + 1;
+	const int32_t validHeight = tileSize - kernel.kernelHeight() + 1;
+	const int32_t tilesX = (width + validWidth - 1) / validWidth;
+	const int32_t tilesY = (height + validHeight - 1) / validHeight;
+	const size_t tileArea = static_cast<size_t>(tileSize) * tileSize;
+	const std::vector<Complex>& spectrum = kernel.spectrum();
+	const FftKernels kernels = selectKernels();
+
+	const int32_t tileCount = tilesX * tilesY;
+
+	// Tiles are processed in pairs. The red and green channels of each tile are one complex tile and the blue channels
+	// of both tiles are the real and imaginary parts of a third one, so a pair takes three transforms instead of four.
+	parallelFor(pool, 0, (tileCount + 1) / 2, 1, [&](int32_t firstPair, int32_t lastPair) {
+		const BufferAllocator<Complex> scratch(destination.allocator());
+		Buffer<Complex> redGreen[2]{ Buffer<Complex>(tileArea, scratch), Buffer<Complex>(tileArea, scratch) };
+		Buffer<Complex> blue(tileArea, scratch);
+		// Blue of the first tile in the even doubles, of the second tile in the odd ones.
+		double* blueValues = reinterpret_cast<double*>(blue.data());
+
+		for (int32_t pair = firstPair; pair < lastPair; pair++)
+		{
+			const int32_t tiles = std::min(2, tileCount - 2 * pair);
+			if (tiles == 1)
+				std::fill(blue.begin(), blue.end(), Complex(0, 0));
+
+			for (int32_t i = 0; i < tiles; i++)
+			{
+				const int32_t tile = 2 * pair + i;
+				const int32_t outputX = (tile % tilesX) * validWidth;
+				const int32_t outputY = (tile / tilesX) * validHeight;
+				for (int32_t y = 0; y < tileSize; y++)
+				{
+					const Color* row = source.row(std::clamp(outputY - halfHeight + y, 0, height - 1));
+					const size_t tileRow = static_cast<size_t>(y) * tileSize;
+					for (int32_t x = 0; x < tileSize; x++)
+					{
+						const Color& color = row[std::clamp(outputX - halfWidth + x, 0, width - 1)];
+						redGreen[i][tileRow + x] = Complex(color.r, color.g);
+						blueValues[2 * (tileRow + x) + i] = color.b;
+					}
+				}
+			}
+
+			for (int32_t i = 0; i < tiles; i++)
+			{
+				fft2d(kernels, redGreen[i].data(), tileSize, kernel.twiddles());
+				kernels.multiplySpectrum(redGreen[i].data(), spectrum.data(), tileArea);
+				fft2d(kernels, redGreen[i].data(), tileSize, kernel.inverseTwiddles());
+			}
+			fft2d(kernels, blue.data(), tileSize, kernel.twiddles());
+			kernels.multiplySpectrum(blue.data(), spectrum.data(), tileArea);
+			fft2d(kernels, blue.data(), tileSize, kernel.inverseTwiddles());
+
+			for (int32_t i = 0; i < tiles; i++)
+			{
+				const int32_t tile = 2 * pair + i;
+				const int32_t outputX = (tile % tilesX) * validWidth;
+				const int32_t outputY = (tile / tilesX) * validHeight;
+				const int32_t rows = std::min(validHeight, height - outputY);
+				const int32_t columns = std::min(validWidth, width - outputX);
+				for (int32_t y = 0; y < rows; y++)
+				{
+					const size_t tileRow = static_cast<size_t>(y + halfHeight) * tileSize + halfWidth;
+					Color* row = destination.row(outputY + y) + outputX;
+					for (int32_t x = 0; x < columns; x++)
+					{
+						const Complex& redGreenValue = redGreen[i][tileRow + x];
+						row[x] = Color(toChannel(redGreenValue.real()), toChannel(redGreenValue.imag()), toChannel(blueValues[2 * (tileRow + x) + i]));
+					}
+				}
+			}
+		}
+	});
+}
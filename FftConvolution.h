@@ -0,0 +1,80 @@
+#pragma once
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Bitmap.h"
+#include "Matrix.h"
+#include "ThreadPool.h"
+
+// Matrices with at least this many elements that aren't separable are applied with convolveFft by
+// Bitmap::applyConvolutionFilter. Below it the direct convolution is faster.
+constexpr size_t fftConvolutionMinArea = 19 * 19;
+
+// Frequency domain form of a convolution matrix for the tile size used by convolveFft. Computing it is a large part
+// of the cost of a small image, so a kernel applied to many bitmaps should be created once and reused.
+class FftKernel
+{
+public:
+	explicit FftKernel(const Matrix& matrix);
+
+	// Returns the kernel of the matrix, reusing the one created by the previous call if the matrix didn't change.
+	static std::shared_ptr<const FftKernel> cached(const Matrix& matrix);
+
+	int32_t kernelWidth() const;
+	int32_t kernelHeight() const;
+	// Width and height of the square tiles the image is transformed in. Always a power of two.
+	int32_t tileSize() const;
+	// tileSize() * tileSize() values, already divided by the number of values to undo the scaling of the transform.
+	const std::vector<std::complex<double>>& spectrum() const;
+	// exp(-2 * pi * i * k / tileSize()) for k in [0, tileSize() / 2).
+	const std::vector<std::complex<double>>& twiddles() const;
+	// Conjugates of the twiddles, for the inverse transform.
+	const std::vector<std::complex<double>>& inverseTwiddles() const;
+
+private:
+	std::vector<float> m_weights;
+	std::vector<std::complex<double>> m_spectrum;
+	std::vector<std::complex<double>> m_twiddles;
+	std::vector<std::complex<double>> m_inverseTwiddles;
+	int32_t m_kernelWidth;
+	int32_t m_kernelHeight;
+	int32_t m_tileSize;
+};
+
+// Same result as convolve, up to rounding, computed with fast Fourier transforms. The image is split into overlapping
+// tiles whose borders are filled with copies of the nearest edge pixel, so the borders match convolve as well.
+// The red and green channels are transformed together as the real and imaginary parts of one complex image. With a
+// pool the tiles are processed on multiple threads.
+void convolveFft(ConstBitmapView source, BitmapView destination, const FftKernel& kernel, ThreadPool* pool = nullptr);
+
+inline int32_t FftKernel::kernelWidth() const
+{
+	return m_kernelWidth;
+}
+
+inline int32_t FftKernel::kernelHeight() const
+{
+	return m_kernelHeight;
+}
+
+inline int32_t FftKernel::tileSize() const
+{
+	return m_tileSize;
+}
+
+inline const std::vector<std::complex<double>>& FftKernel::spectrum() const
+{
+	return m_spectrum;
+}
+
+inline const std::vector<std::complex<double>>& FftKernel::twiddles() const
+{
+	return m_twiddles;
+}
+
+inline const std::vector<std::complex<double>>& FftKernel::inverseTwiddles() const
+{
+	return m_inverseTwiddles;
+}
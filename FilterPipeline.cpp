@@ -0,0 +1,180 @@
+#include "FilterPipeline.h"
+#include "Convolution.h"
+#include "Median.h"
+#include "IntegralImage.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+static int32_t addHalo(int32_t halo, int32_t radius)
+{
+	return static_cast<int32_t>(std::min<int64_t>(static_cast<int64_t>(halo) + radius, std::numeric_limits<int32_t>::max()));
+}
+
+// The rectangle grown by the radii and clipped to the image.
+static Rect expand(const Rect& rect, int32_t radiusX, int32_t radiusY, int32_t width, int32_t height)
+{
+	const int32_t left = static_cast<int32_t>(std::max<int64_t>(static_cast<int64_t>(rect.x) - radiusX, 0));
+	const int32_t top = static_cast<int32_t>(std::max<int64_t>(static_cast<int64_t>(rect.y) - radiusY, 0));
+	const int32_t right = static_cast<int32_t>(std::min<int64_t>(static_cast<int64_t>(rect.x) + rect.width + radiusX, width));
+	const int32_t bottom = static_cast<int32_t>(std::min<int64_t>(static_cast<int64_t>(rect.y) + rect.height + radiusY, height));
+	return Rect{ left, top, right - left, bottom - top };
+}
+
+static void copyPixels(ConstBitmapView source, BitmapView destination)
+{
+	for (int32_t y = 0; y < source.height(); y++)
+		memcpy(destination.row(y), source.row(y), sizeof(Color) * source.width());
+}
+
+FilterPipeline& FilterPipeline::addConvolutionFilter(const Matrix& matrix)
+{
+	if (!(matrix.width() & 1 && matrix.height() & 1))
+		throw std::runtime_error("Matrix width and height must be an odd number.");
+
+	std::vector<float> horizontal, vertical;
+	if (matrix.separate(horizontal, vertical))
+		return addConvolutionFilter(horizontal, vertical);
+
+	const int32_t radiusX = static_cast<int32_t>(matrix.width() / 2);
+	const int32_t radiusY = static_cast<int32_t>(matrix.height() / 2);
+	m_stages.push_back({ radiusX, radiusY, [matrix](ConstBitmapView source, BitmapView destination) {
+		convolve(source, destination, matrix);
+	}, nullptr });
+	m_haloX = addHalo(m_haloX, radiusX);
+	m_haloY = addHalo(m_haloY, radiusY);
+	return *this;
+}
+
+FilterPipeline& FilterPipeline::addConvolutionFilter(const std::vector<float>& horizontal, const std::vector<float>& vertical)
+{
+	if (!(horizontal.size() & 1 && vertical.size() & 1))
+		throw std::runtime_error("Kernel sizes must be odd numbers.");
+
+	const int32_t radiusX = static_cast<int32_t>(horizontal.size() / 2);
+	const int32_t radiusY = static_cast<int32_t>(vertical.size() / 2);
+	m_stages.push_back({ radiusX, radiusY, [horizontal, vertical](ConstBitmapView source, BitmapView destination) {
+		convolveSeparable(source, destination, horizontal, vertical);
+	}, nullptr });
+	m_haloX = addHalo(m_haloX, radiusX);
+	m_haloY = addHalo(m_haloY, radiusY);
+	return *this;
+}
+
+FilterPipeline& FilterPipeline::addMedianFilter(int32_t radius)
+{
+	if (radius < 0 || 2 * static_cast<int64_t>(radius) + 1 > std::numeric_limits<uint16_t>::max())
+		throw std::runtime_error("Median filter radius out of range.");
+
+	m_stages.push_back({ radius, radius, [radius](ConstBitmapView source, BitmapView destination) {
+		medianFilter(source, destination, radius);
+	}, nullptr });
+	m_haloX = addHalo(m_haloX, radius);
+	m_haloY = addHalo(m_haloY, radius);
+	return *this;
+}
+
+FilterPipeline& FilterPipeline::addBoxBlur(int32_t radius)
+{
+	if (radius < 0 || radius > (1 << 27))
+		throw std::runtime_error("Invalid radius.");
+
+	m_stages.push_back({ radius, radius, [radius](ConstBitmapView source, BitmapView destination) {
+		boxBlur(IntegralImage(source), destination, radius);
+	}, nullptr });
+	m_haloX = addHalo(m_haloX, radius);
+	m_haloY = addHalo(m_haloY, radius);
+	return *this;
+}
+
+FilterPipeline& FilterPipeline::addPixelOperation(PixelOperation operation)
+{
+	if (!operation)
+		throw std::runtime_error("Empty pixel operation.");
+
+	m_stages.push_back({ 0, 0, nullptr, std::move(operation) });
+	return *this;
+}
+
+void FilterPipeline::apply(ConstBitmapView source, BitmapView destination, ThreadPool* pool) const
+{
+	const int32_t width = source.width();
+	const int32_t height = source.height();
+	if (destination.width() != width || destination.height() != height)
+		throw std::runtime_error("Bitmap sizes don't match.");
+	if (width == 0 || height == 0)
+		return;
+
+	const int32_t tilesX = (width + filterPipelineTileSize - 1) / filterPipelineTileSize;
+	const int32_t tilesY = (height + filterPipelineTileSize - 1) / filterPipelineTileSize;
+	// Every intermediate image of a tile fits into the tile grown by the full halo.
+	const size_t bufferWidth = static_cast<size_t>(std::min<int64_t>(filterPipelineTileSize + 2 * static_cast<int64_t>(m_haloX), width));
+	const size_t bufferHeight = static_cast<size_t>(std::min<int64_t>(filterPipelineTileSize + 2 * static_cast<int64_t>(m_haloY), height));
+	const int32_t tileCount = tilesX * tilesY;
+	// A few chunks of tiles per thread, so the scratch memory below is set up once per chunk instead of per tile.
+	const int32_t threadCount = pool != nullptr ? static_cast<int32_t>(pool->threadCount()) : 1;
+	const int32_t grainSize = std::max(tileCount / (4 * threadCount), 1);
+
+	parallelFor(pool, 0, tileCount, grainSize, [&](int32_t firstTile, int32_t lastTile) {
+		// The stages allocate their scratch buffers with the allocator of the views they are given. Routing them
+		// through a pool of the chunk means only the first tile allocates and later ones reuse the same memory.
+		PoolAllocator allocator(destination.allocator());
+		// The stages alternate between the buffers. Pixel operations modify the current one in place. Bitmaps
+		// because, unlike a Buffer, they don't clear their pixels.
+		Bitmap buffers[2]{
+			Bitmap(static_cast<int>(bufferWidth), static_cast<int>(bufferHeight), allocator),
+			Bitmap(static_cast<int>(bufferWidth), static_cast<int>(bufferHeight), allocator)
+		};
+		// regions[i] is the part of the image the input of stage i has to cover, the last one is the tile.
+		std::vector<Rect> regions(m_stages.size() + 1);
+
+		for (int32_t tile = firstTile; tile < lastTile; tile++)
+		{
+			const int32_t tileX = tile % tilesX * filterPipelineTileSize;
+			const int32_t tileY = tile / tilesX * filterPipelineTileSize;
+			regions.back() = Rect{ tileX, tileY, std::min(filterPipelineTileSize, width - tileX), std::min(filterPipelineTileSize, height - tileY) };
+			for (size_t i = m_stages.size(); i-- > 0;)
+				regions[i] = expand(regions[i + 1], m_stages[i].radiusX, m_stages[i].radiusY, width, height);
+
+			const Rect& first = regions.front();
+			const ConstBitmapView firstRegion = source.region(first.x, first.y, first.width, first.height);
+			ConstBitmapView current(firstRegion.pixelData(), first.width, first.height, firstRegion.stride(), allocator);
+			// Set once current is in one of the buffers and can be modified.
+			BitmapView writable(nullptr, 0, 0, 0, allocator);
+			bool inBuffer = false;
+			size_t next = 0;
+
+			for (size_t i = 0; i < m_stages.size(); i++)
+			{
+				const Stage& stage = m_stages[i];
+				const Rect& input = regions[i];
+				const Rect& output = regions[i + 1];
+				if (stage.filter)
+				{
+					BitmapView result(buffers[next].pixelData(), input.width, input.height, input.width, allocator);
+					next ^= 1;
+					stage.filter(current, result);
+					writable = result.region(output.x - input.x, output.y - input.y, output.width, output.height);
+				}
+				else
+				{
+					if (!inBuffer)
+					{
+						writable = BitmapView(buffers[next].pixelData(), input.width, input.height, input.width, allocator);
+						next ^= 1;
+						copyPixels(current, writable);
+					}
+					for (int32_t y = 0; y < writable.height(); y++)
+						stage.pixelOperation(writable.row(y), writable.width());
+				}
+				current = writable;
+				inBuffer = true;
+			}
+
+			const Rect& last = regions.back();
+			copyPixels(current, destination.region(last.x, last.y, last.width, last.height));
+		}
+	});
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Bitmap.h"
+#include "Matrix.h"
+#include "ThreadPool.h"
+
+// Width and height of the destination tiles a FilterPipeline runs through all of its stages at once.
+constexpr int32_t filterPipelineTileSize = 256;
+
+// Sequence of filters applied in a single pass over the image. The destination is split into tiles and every tile
+// goes through all stages before the next one starts, so the intermediate images are tile sized and stay in the cache
+// instead of making a full pass through memory per filter. A stage that reads a neighbourhood needs the output of the
+// previous stage around the tile as well. These halos are recomputed by every tile that needs them.
+// Every stage treats pixels outside of the image as copies of the nearest edge pixel, so the result is identical to
+// applying the filters one after another with the Bitmap members. The exception are large matrices, which are always
+// convolved directly instead of with FFTs. The Gaussian blur depends on the whole image and can't be part of a pipeline.
+class FilterPipeline
+{
+public:
+	// Modifies count pixels in place. Called for parts of rows from multiple threads at once if a pool is used.
+	using PixelOperation = std::function<void(Color* pixels, int32_t count)>;
+
+	// The stages are applied in the order they are added. Each function returns the pipeline, so calls can be chained.
+	// Separable matrices are detected and applied as two one dimensional passes.
+	FilterPipeline& addConvolutionFilter(const Matrix& matrix);
+	FilterPipeline& addConvolutionFilter(const std::vector<float>& horizontal, const std::vector<float>& vertical);
+	FilterPipeline& addMedianFilter(int32_t radius);
+	FilterPipeline& addBoxBlur(int32_t radius);
+	FilterPipeline& addPixelOperation(PixelOperation operation);
+
+	size_t stageCount() const;
+	// Pixels around a destination tile that are read from the source, horizontally and vertically.
+	int32_t haloX() const;
+	int32_t haloY() const;
+
+	// Runs all stages over the source. The destination has to be the same size and mustn't overlap with the source.
+	// With a pool the tiles are processed on multiple threads. The scratch buffers are allocated with the allocator of
+	// the destination, once per chunk of tiles, and reused by all tiles of the chunk.
+	void apply(ConstBitmapView source, BitmapView destination, ThreadPool* pool = nullptr) const;
+
+private:
+	struct Stage
+	{
+		int32_t radiusX;
+		int32_t radiusY;
+		// Set for stages that read a neighbourhood. Writes every pixel of the destination, which has the size of the
+		// source, but only the pixels at least the radius away from the sides that aren't sides of the image are used.
+		std::function<void(ConstBitmapView source, BitmapView destination)> filter;
+		// Set for stages that only read the pixel they write.
+		PixelOperation pixelOperation;
+	};
+
+	std::vector<Stage> m_stages;
+	int32_t m_haloX = 0;
+	int32_t m_haloY = 0;
+};
+
+inline size_t FilterPipeline::stageCount() const
+{
+	return m_stages.size();
+}
+
+inline int32_t FilterPipeline::haloX() const
+{
+	return m_haloX;
+}
+
+inline int32_t FilterPipeline::haloY() const
+{
+	return m_haloY;
+}
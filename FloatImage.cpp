@@ -0,0 +1,164 @@
+#include "FloatImage.h"
+#include "PixelConversion.h"
+#include "intrinsics.h"
+#include <stdexcept>
+
+// Floats per 64 bytes, the multiple the stride is rounded up to.
+static constexpr int32_t rowAlignment = static_cast<int32_t>(bufferAlignment / sizeof(float));
+
+FloatImage::FloatImage(int32_t width, int32_t height, Allocator& allocator)
+	:m_planes(BufferAllocator<float>(allocator))
+	, m_width(width)
+	, m_height(height)
+{
+	if (width < 0 || height < 0 || width > INT32_MAX - rowAlignment)
+		throw std::runtime_error("Invalid image size.");
+
+	m_stride = (width + rowAlignment - 1) / rowAlignment * rowAlignment;
+	m_planeSize = static_cast<size_t>(m_stride) * static_cast<size_t>(height);
+	m_planes.resize(channelCount * m_planeSize);
+}
+
+FloatImage::FloatImage(ConstBitmapView bitmap, ThreadPool* pool)
+	:FloatImage(bitmap.width(), bitmap.height(), bitmap.allocator())
+{
+	parallelFor(pool, 0, m_height, 0, [&](int32_t firstRow, int32_t lastRow) {
+		for (int32_t y = firstRow; y < lastRow; y++)
+		{
+			float* const planes[channelCount] = { row(Red, y), row(Green, y), row(Blue, y), row(Alpha, y) };
+			colorsToPlanes(bitmap.row(y), planes, m_width);
+		}
+	});
+}
+
+void FloatImage::toBitmap(BitmapView destination, ThreadPool* pool) const
+{
+	if (destination.width() != m_width || destination.height() != m_height)
+		throw std::runtime_error("Image sizes don't match.");
+
+	parallelFor(pool, 0, m_height, 0, [&](int32_t firstRow, int32_t lastRow) {
+		for (int32_t y = firstRow; y < lastRow; y++)
+		{
+			const float* const planes[channelCount] = { row(Red, y), row(Green, y), row(Blue, y), row(Alpha, y) };
+			planesToColors(planes, destination.row(y), m_width);
+		}
+	});
+}
+
+ColorMatrix ColorMatrix::identity()
+{
+	return ColorMatrix{ {
+		{ 1, 0, 0, 0 },
+		{ 0, 1, 0, 0 },
+		{ 0, 0, 1, 0 },
+		{ 0, 0, 0, 1 }
+	}, { 0, 0, 0, 0 } };
+}
+
+ColorMatrix ColorMatrix::grayscale()
+{
+	return ColorMatrix{ {
+		{ 0.3f, 0.59f, 0.11f, 0 },
+		{ 0.3f, 0.59f, 0.11f, 0 },
+		{ 0.3f, 0.59f, 0.11f, 0 },
+		{ 0, 0, 0, 1 }
+	}, { 0, 0, 0, 0 } };
+}
+
+ColorMatrix ColorMatrix::invert()
+{
+	return ColorMatrix{ {
+		{ -1, 0, 0, 0 },
+		{ 0, -1, 0, 0 },
+		{ 0, 0, -1, 0 },
+		{ 0, 0, 0, 1 }
+	}, { 255, 255, 255, 0 } };
+}
+
+// The terms are added in the order of the formula in all paths and without fused multiply-add, so the results are
+// bit identical.
+
+static void transformRowScalar(float* const planes[4], int32_t begin, int32_t end, const ColorMatrix& matrix)
+{
+	for (int32_t x = begin; x < end; x++)
+	{
+		const float in[4]{ planes[0][x], planes[1][x], planes[2][x], planes[3][x] };
+		for (int c = 0; c < 4; c++)
+		{
+			const float* weights = matrix.matrix[c];
+			planes[c][x] = matrix.offset[c] + weights[0] * in[0] + weights[1] * in[1] + weights[2] * in[2] + weights[3] * in[3];
+		}
+	}
+}
+
+#ifdef BITMAP_X86
+
+TARGET_SSE41 static void transformRowSse41(float* const planes[4], int32_t begin, int32_t end, const ColorMatrix& matrix)
+{
+	int32_t x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		__m128 in[4];
+		for (int c = 0; c < 4; c++)
+			in[c] = _mm_loadu_ps(planes[c] + x);
+		for (int c = 0; c < 4; c++)
+		{
+			const float* weights = matrix.matrix[c];
+			__m128 out = _mm_set1_ps(matrix.offset[c]);
+			for (int k = 0; k < 4; k++)
+				out = _mm_add_ps(out, _mm_mul_ps(_mm_set1_ps(weights[k]), in[k]));
+			_mm_storeu_ps(planes[c] + x, out);
+		}
+	}
+	transformRowScalar(planes, x, end, matrix);
+}
+
+TARGET_AVX2 static void transformRowAvx2(float* const planes[4], int32_t begin, int32_t end, const ColorMatrix& matrix)
+{
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		__m256 in[4];
+		for (int c = 0; c < 4; c++)
+			in[c] = _mm256_loadu_ps(planes[c] + x);
+		for (int c = 0; c < 4; c++)
+		{
+			const float* weights = matrix.matrix[c];
+			__m256 out = _mm256_set1_ps(matrix.offset[c]);
+			for (int k = 0; k < 4; k++)
+				out = _mm256_add_ps(out, _mm256_mul_ps(_mm256_set1_ps(weights[k]), in[k]));
+			_mm256_storeu_ps(planes[c] + x, out);
+		}
+	}
+	transformRowSse41(planes, x, end, matrix);
+}
+
+#endif
+
+void transformColors(FloatImage& image, const ColorMatrix& matrix, ThreadPool* pool)
+{
+	auto transformRow = transformRowScalar;
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		transformRow = transformRowAvx2;
+		break;
+	case SimdLevel::Sse41:
+		transformRow = transformRowSse41;
+		break;
+	default:
+		break;
+	}
+#endif
+
+	parallelFor(pool, 0, image.height(), 0, [&](int32_t firstRow, int32_t lastRow) {
+		for (int32_t y = firstRow; y < lastRow; y++)
+		{
+			float* const planes[FloatImage::channelCount] = {
+				image.row(FloatImage::Red, y), image.row(FloatImage::Green, y), image.row(FloatImage::Blue, y), image.row(FloatImage::Alpha, y)
+			};
+			transformRow(planes, 0, image.width(), matrix);
+		}
+	});
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "Allocator.h"
+#include "BitmapView.h"
+#include "ThreadPool.h"
+
+// Planar float companion of Bitmap for chains of filters. Every channel is a separate plane of floats on the same
+// scale as the channels of a Color, 0 to 255, but not clamped or rounded, so intermediate results keep their precision
+// and the filters skip the conversions from and to Color at every step. Rows are padded to a multiple of 64 bytes and
+// every row starts on a 64 byte boundary, so a row of a plane is one contiguous run for SIMD loads.
+class FloatImage
+{
+public:
+	// Index of a plane.
+	enum Channel : int32_t
+	{
+		Red,
+		Green,
+		Blue,
+		Alpha
+	};
+	static constexpr int32_t channelCount = 4;
+
+	// All values are 0. The planes are allocated with the allocator, which also provides the scratch buffers of the
+	// filters writing to the image.
+	FloatImage(int32_t width, int32_t height, Allocator& allocator = defaultAllocator());
+	// Converts the pixels of the bitmap, using the allocator of the view.
+	explicit FloatImage(ConstBitmapView bitmap, ThreadPool* pool = nullptr);
+
+	int32_t width() const;
+	int32_t height() const;
+	// Distance between rows of a plane in floats.
+	int32_t stride() const;
+	Allocator& allocator() const;
+	float* row(int32_t channel, int32_t y);
+	const float* row(int32_t channel, int32_t y) const;
+
+	// Converts to colors, clamped to [0, 255] and rounded to the nearest integer. The destination has to be the same
+	// size.
+	void toBitmap(BitmapView destination, ThreadPool* pool = nullptr) const;
+
+private:
+	Buffer<float> m_planes;
+	int32_t m_width;
+	int32_t m_height;
+	int32_t m_stride;
+	size_t m_planeSize;
+};
+
+// Affine map of the channels of every pixel. The new value of channel c is
+// offset[c] + matrix[c][0] * red + matrix[c][1] * green + matrix[c][2] * blue + matrix[c][3] * alpha.
+struct ColorMatrix
+{
+	float matrix[4][4];
+	float offset[4];
+
+	static ColorMatrix identity();
+	// Same weights as Color::grayscale, without rounding. Alpha is kept.
+	static ColorMatrix grayscale();
+	// 255 - value for red, green and blue like Color::invert. Alpha is kept.
+	static ColorMatrix invert();
+};
+
+// Applies the matrix to the pixels in place. The values aren't clamped.
+void transformColors(FloatImage& image, const ColorMatrix& matrix, ThreadPool* pool = nullptr);
+
+inline int32_t FloatImage::width() const
+{
+	return m_width;
+}
+
+inline int32_t FloatImage::height() const
+{
+	return m_height;
+}
+
+inline int32_t FloatImage::stride() const
+{
+	return m_stride;
+}
+
+inline Allocator& FloatImage::allocator() const
+{
+	return m_planes.get_allocator().allocator();
+}
+
+inline float* FloatImage::row(int32_t channel, int32_t y)
+{
+	return m_planes.data() + channel * m_planeSize + static_cast<size_t>(y) * m_stride;
+}
+
+inline const float* FloatImage::row(int32_t channel, int32_t y) const
+{
+	return m_planes.data() + channel * m_planeSize + static_cast<size_t>(y) * m_stride;
+}
@@ -0,0 +1,496 @@
+#include "GaussianBlur.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+// Young and van Vliet, "Recursive implementation of the Gaussian filter".
+// A causal third order filter y[n] = gain * x[n] + feedback[0] * y[n - 1] + feedback[1] * y[n - 2] + feedback[2] * y[n - 3]
+// followed by the same filter running backwards approximates the Gaussian. The gain makes both filters keep constant
+// signals unchanged, so a clamped left edge starts the forward filter with its state set to the first value.
+// Triggs and Sdika, "Boundary conditions for Young-van Vliet recursive filtering".
+// The state the backward filter would have after running in from a clamped right edge is a linear function of how far
+// the last three forward outputs are from the edge value. boundary holds that function, already scaled by the gain.
+// For large sigmas the gain gets tiny and the poles close to one, which amplifies rounding errors in the filter state
+// enough to visibly change the brightness with floats, so the state is kept in doubles.
+
+struct RecursiveGaussian
+{
+	double gain;
+	double feedback[3];
+	double boundary[9];
+};
+
+static RecursiveGaussian recursiveGaussian(float sigma)
+{
+	const double q = sigma >= 2.5f ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * std::sqrt(1 - 0.26891 * sigma);
+	const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q * q + 0.422205 * q * q * q;
+	const double a1 = (2.44413 * q + 2.85619 * q * q + 1.26661 * q * q * q) / b0;
+	const double a2 = -(1.4281 * q * q + 1.26661 * q * q * q) / b0;
+	const double a3 = 0.422205 * q * q * q / b0;
+	const double gain = 1 - a1 - a2 - a3;
+
+	const double scale = gain / ((1 + a1 - a2 + a3) * (1 - a1 - a2 - a3) * (1 + a2 + (a1 - a3) * a3));
+	const double boundary[9]{
+		scale * (-a3 * a1 + 1 - a3 * a3 - a2),
+		scale * (a3 + a1) * (a2 + a3 * a1),
+		scale * a3 * (a1 + a3 * a2),
+		scale * (a1 + a3 * a2),
+		-scale * (a2 - 1) * (a2 + a3 * a1),
+		-scale * a3 * (a3 * a1 + a3 * a3 + a2 - 1),
+		scale * (a3 * a1 + a2 + a1 * a1 - a2 * a2),
+		scale * (a1 * a2 + a3 * a2 * a2 - a1 * a3 * a3 - a3 * a3 * a3 - a3 * a2 + a3),
+		scale * a3 * (a1 + a3 * a2)
+	};
+
+	RecursiveGaussian filter{ gain, { a1, a2, a3 }, {} };
+	std::copy(std::begin(boundary), std::end(boundary), filter.boundary);
+	return filter;
+}
+
+// Columns filtered together by the vertical pass. Four pixels of floats fill a cache line.
+static constexpr int32_t columnBlock = 4;
+
+// The channels of a pixel are processed in the memory order of Color - alpha, blue, green, red. Values between the
+// passes are stored as floats.
+
+static void loadChannels(const Color& color, float* channels)
+{
+	channels[0] = color.a;
+	channels[1] = color.b;
+	channels[2] = color.g;
+	channels[3] = color.r;
+}
+
+static uint8_t storeChannel(double channel)
+{
+	return static_cast<uint8_t>(std::nearbyint(std::clamp(static_cast<float>(channel), 0.f, 255.f)));
+}
+
+// The filter state of one lane: the last three outputs, newest first.
+struct LaneState
+{
+	double y1;
+	double y2;
+	double y3;
+
+	double step(double x, const RecursiveGaussian& filter)
+	{
+		const double y = filter.gain * x + filter.feedback[0] * y1 + filter.feedback[1] * y2 + filter.feedback[2] * y3;
+		y3 = y2;
+		y2 = y1;
+		y1 = y;
+		return y;
+	}
+
+	// Turns the state left by the forward filter into the state of the backward filter one past the end and returns
+	// the backward output for the last element.
+	double reverse(double edge, const RecursiveGaussian& filter)
+	{
+		const double e0 = y1 - edge, e1 = y2 - edge, e2 = y3 - edge;
+		const double* m = filter.boundary;
+		const double last = edge + m[0] * e0 + m[1] * e1 + m[2] * e2;
+		y2 = edge + m[3] * e0 + m[4] * e1 + m[5] * e2;
+		y3 = edge + m[6] * e0 + m[7] * e1 + m[8] * e2;
+		y1 = last;
+		return last;
+	}
+};
+
+// Filters one row of pixels horizontally into four floats per pixel.
+static void blurRowScalar(const Color* pixels, float* output, int32_t width, const RecursiveGaussian& filter)
+{
+	float first[4], last[4];
+	loadChannels(pixels[0], first);
+	loadChannels(pixels[width - 1], last);
+	LaneState states[4];
+	for (int c = 0; c < 4; c++)
+		states[c] = LaneState{ first[c], first[c], first[c] };
+
+	for (int32_t x = 0; x < width; x++)
+	{
+		float channels[4];
+		loadChannels(pixels[x], channels);
+		for (int c = 0; c < 4; c++)
+			output[4 * x + c] = static_cast<float>(states[c].step(channels[c], filter));
+	}
+
+	for (int c = 0; c < 4; c++)
+		output[4 * (width - 1) + c] = static_cast<float>(states[c].reverse(last[c], filter));
+	for (int32_t x = width - 2; x >= 0; x--)
+	{
+		for (int c = 0; c < 4; c++)
+			output[4 * x + c] = static_cast<float>(states[c].step(output[4 * x + c], filter));
+	}
+}
+
+// Filters the columns [begin, end) of the horizontally filtered rows vertically and writes the pixels. The rows are
+// overwritten by the forward pass.
+static void blurColumnsScalar(float* rows, BitmapView destination, int32_t begin, int32_t end, const RecursiveGaussian& filter)
+{
+	const int32_t height = destination.height();
+	const size_t rowSize = 4 * static_cast<size_t>(destination.width());
+	const int32_t lanes = 4 * (end - begin);
+	float* firstRow = rows + 4 * static_cast<size_t>(begin);
+	float* lastRow = firstRow + (height - 1) * rowSize;
+
+	LaneState states[4 * columnBlock];
+	float edges[4 * columnBlock];
+	for (int32_t i = 0; i < lanes; i++)
+	{
+		states[i] = LaneState{ firstRow[i], firstRow[i], firstRow[i] };
+		edges[i] = lastRow[i];
+	}
+
+	for (int32_t y = 0; y < height; y++)
+	{
+		float* row = firstRow + y * rowSize;
+		for (int32_t i = 0; i < lanes; i++)
+			row[i] = static_cast<float>(states[i].step(row[i], filter));
+	}
+
+	for (int32_t y = height - 1; y >= 0; y--)
+	{
+		const float* row = firstRow + y * rowSize;
+		double channels[4 * columnBlock];
+		for (int32_t i = 0; i < lanes; i++)
+			channels[i] = y == height - 1 ? states[i].reverse(edges[i], filter) : states[i].step(row[i], filter);
+
+		Color* pixels = destination.row(y) + begin;
+		for (int32_t x = 0; x < end - begin; x++)
+		{
+			const double* pixel = channels + 4 * x;
+			pixels[x] = Color(storeChannel(pixel[3]), storeChannel(pixel[2]), storeChannel(pixel[1]), storeChannel(pixel[0]));
+		}
+	}
+}
+
+// Columns of a plane filtered together by the vertical pass of float images, a cache line of floats.
+static constexpr int32_t planeColumnBlock = 16;
+
+// Filters one row of all four planes horizontally. The four channels are independent chains, interleaved so they
+// overlap in the pipeline.
+static void blurPlaneRowScalar(const float* const source[4], float* const destination[4], int32_t width, const RecursiveGaussian& filter)
+{
+	LaneState states[4];
+	float last[4];
+	for (int c = 0; c < 4; c++)
+	{
+		states[c] = LaneState{ source[c][0], source[c][0], source[c][0] };
+		last[c] = source[c][width - 1];
+	}
+
+	for (int32_t x = 0; x < width; x++)
+	{
+		for (int c = 0; c < 4; c++)
+			destination[c][x] = static_cast<float>(states[c].step(source[c][x], filter));
+	}
+
+	for (int c = 0; c < 4; c++)
+		destination[c][width - 1] = static_cast<float>(states[c].reverse(last[c], filter));
+	for (int32_t x = width - 2; x >= 0; x--)
+	{
+		for (int c = 0; c < 4; c++)
+			destination[c][x] = static_cast<float>(states[c].step(destination[c][x], filter));
+	}
+}
+
+// Filters the columns [begin, end) of a plane vertically in place.
+static void blurPlaneColumnsScalar(float* plane, size_t stride, int32_t height, int32_t begin, int32_t end, const RecursiveGaussian& filter)
+{
+	const int32_t lanes = end - begin;
+	float* firstRow = plane + begin;
+	const float* lastRow = firstRow + (height - 1) * stride;
+
+	LaneState states[planeColumnBlock];
+	float edges[planeColumnBlock];
+	for (int32_t i = 0; i < lanes; i++)
+	{
+		states[i] = LaneState{ firstRow[i], firstRow[i], firstRow[i] };
+		edges[i] = lastRow[i];
+	}
+
+	for (int32_t y = 0; y < height; y++)
+	{
+		float* row = firstRow + y * stride;
+		for (int32_t i = 0; i < lanes; i++)
+			row[i] = static_cast<float>(states[i].step(row[i], filter));
+	}
+
+	for (int32_t y = height - 1; y >= 0; y--)
+	{
+		float* row = firstRow + y * stride;
+		for (int32_t i = 0; i < lanes; i++)
+			row[i] = static_cast<float>(y == height - 1 ? states[i].reverse(edges[i], filter) : states[i].step(row[i], filter));
+	}
+}
+
+#ifdef BITMAP_X86
+
+// The same filter with the four channels of a pixel in one register.
+
+struct PixelFilter
+{
+	__m256d gain;
+	__m256d feedback[3];
+	__m256d boundary[9];
+};
+
+struct PixelState
+{
+	__m256d y1;
+	__m256d y2;
+	__m256d y3;
+};
+
+TARGET_AVX2 static PixelFilter pixelFilter(const RecursiveGaussian& filter)
+{
+	PixelFilter result;
+	result.gain = _mm256_set1_pd(filter.gain);
+	for (int i = 0; i < 3; i++)
+		result.feedback[i] = _mm256_set1_pd(filter.feedback[i]);
+	for (int i = 0; i < 9; i++)
+		result.boundary[i] = _mm256_set1_pd(filter.boundary[i]);
+	return result;
+}
+
+TARGET_AVX2 static inline __m256d loadPixel(const Color& color)
+{
+	return _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(color.value))));
+}
+
+TARGET_AVX2 static inline Color storePixel(__m256d channels)
+{
+	const __m128 clamped = _mm_min_ps(_mm_max_ps(_mm256_cvtpd_ps(channels), _mm_setzero_ps()), _mm_set1_ps(255.f));
+	const __m128i values = _mm_cvtps_epi32(clamped);
+	const __m128i words = _mm_packus_epi32(values, values);
+	return Color(static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words))));
+}
+
+TARGET_AVX2 static inline __m256d step(PixelState& state, __m256d x, const PixelFilter& filter)
+{
+	__m256d y = _mm256_add_pd(_mm256_mul_pd(filter.gain, x), _mm256_mul_pd(filter.feedback[0], state.y1));
+	y = _mm256_add_pd(y, _mm256_mul_pd(filter.feedback[1], state.y2));
+	y = _mm256_add_pd(y, _mm256_mul_pd(filter.feedback[2], state.y3));
+	state.y3 = state.y2;
+	state.y2 = state.y1;
+	state.y1 = y;
+	return y;
+}
+
+TARGET_AVX2 static inline __m256d boundaryRow(const __m256d* m, __m256d edge, __m256d e0, __m256d e1, __m256d e2)
+{
+	__m256d y = _mm256_add_pd(edge, _mm256_mul_pd(m[0], e0));
+	y = _mm256_add_pd(y, _mm256_mul_pd(m[1], e1));
+	return _mm256_add_pd(y, _mm256_mul_pd(m[2], e2));
+}
+
+TARGET_AVX2 static inline __m256d reverse(PixelState& state, __m256d edge, const PixelFilter& filter)
+{
+	const __m256d e0 = _mm256_sub_pd(state.y1, edge), e1 = _mm256_sub_pd(state.y2, edge), e2 = _mm256_sub_pd(state.y3, edge);
+	state.y1 = boundaryRow(filter.boundary, edge, e0, e1, e2);
+	state.y2 = boundaryRow(filter.boundary + 3, edge, e0, e1, e2);
+	state.y3 = boundaryRow(filter.boundary + 6, edge, e0, e1, e2);
+	return state.y1;
+}
+
+TARGET_AVX2 static inline __m256d loadFloats(const float* values)
+{
+	return _mm256_cvtps_pd(_mm_loadu_ps(values));
+}
+
+TARGET_AVX2 static inline void storeFloats(float* values, __m256d channels)
+{
+	_mm_storeu_ps(values, _mm256_cvtpd_ps(channels));
+}
+
+TARGET_AVX2 static void blurRowAvx2(const Color* pixels, float* output, int32_t width, const RecursiveGaussian& gaussian)
+{
+	const PixelFilter filter = pixelFilter(gaussian);
+	const __m256d first = loadPixel(pixels[0]);
+	PixelState state{ first, first, first };
+
+	for (int32_t x = 0; x < width; x++)
+		storeFloats(output + 4 * x, step(state, loadPixel(pixels[x]), filter));
+
+	storeFloats(output + 4 * (width - 1), reverse(state, loadPixel(pixels[width - 1]), filter));
+	for (int32_t x = width - 2; x >= 0; x--)
+		storeFloats(output + 4 * x, step(state, loadFloats(output + 4 * x), filter));
+}
+
+TARGET_AVX2 static void blurColumnsAvx2(float* rows, BitmapView destination, int32_t begin, int32_t end, const RecursiveGaussian& gaussian)
+{
+	const PixelFilter filter = pixelFilter(gaussian);
+	const int32_t height = destination.height();
+	const size_t rowSize = 4 * static_cast<size_t>(destination.width());
+	const int32_t count = end - begin;
+	float* firstRow = rows + 4 * static_cast<size_t>(begin);
+	float* lastRow = firstRow + (height - 1) * rowSize;
+
+	PixelState states[columnBlock];
+	__m256d edges[columnBlock];
+	for (int32_t i = 0; i < count; i++)
+	{
+		const __m256d first = loadFloats(firstRow + 4 * i);
+		states[i] = PixelState{ first, first, first };
+		edges[i] = loadFloats(lastRow + 4 * i);
+	}
+
+	for (int32_t y = 0; y < height; y++)
+	{
+		float* row = firstRow + y * rowSize;
+		for (int32_t i = 0; i < count; i++)
+			storeFloats(row + 4 * i, step(states[i], loadFloats(row + 4 * i), filter));
+	}
+
+	for (int32_t y = height - 1; y >= 0; y--)
+	{
+		const float* row = firstRow + y * rowSize;
+		Color* pixels = destination.row(y) + begin;
+		for (int32_t i = 0; i < count; i++)
+			pixels[i] = storePixel(y == height - 1 ? reverse(states[i], edges[i], filter) : step(states[i], loadFloats(row + 4 * i), filter));
+	}
+}
+
+TARGET_AVX2 static inline __m256d loadPlanes(const float* const planes[4], int32_t x)
+{
+	return _mm256_cvtps_pd(_mm_setr_ps(planes[0][x], planes[1][x], planes[2][x], planes[3][x]));
+}
+
+TARGET_AVX2 static inline void storePlanes(float* const planes[4], int32_t x, __m256d channels)
+{
+	const __m128 values = _mm256_cvtpd_ps(channels);
+	_mm_store_ss(planes[0] + x, values);
+	_mm_store_ss(planes[1] + x, _mm_shuffle_ps(values, values, 1));
+	_mm_store_ss(planes[2] + x, _mm_shuffle_ps(values, values, 2));
+	_mm_store_ss(planes[3] + x, _mm_shuffle_ps(values, values, 3));
+}
+
+TARGET_AVX2 static void blurPlaneRowAvx2(const float* const source[4], float* const destination[4], int32_t width, const RecursiveGaussian& gaussian)
+{
+	const PixelFilter filter = pixelFilter(gaussian);
+	const __m256d first = loadPlanes(source, 0);
+	const __m256d last = loadPlanes(source, width - 1);
+	PixelState state{ first, first, first };
+
+	for (int32_t x = 0; x < width; x++)
+		storePlanes(destination, x, step(state, loadPlanes(source, x), filter));
+
+	storePlanes(destination, width - 1, reverse(state, last, filter));
+	for (int32_t x = width - 2; x >= 0; x--)
+		storePlanes(destination, x, step(state, loadPlanes(destination, x), filter));
+}
+
+// Four adjacent columns of a plane in one register.
+TARGET_AVX2 static void blurPlaneColumnsAvx2(float* plane, size_t stride, int32_t height, int32_t begin, int32_t end, const RecursiveGaussian& gaussian)
+{
+	const PixelFilter filter = pixelFilter(gaussian);
+	const int32_t count = (end - begin) / 4;
+	float* firstRow = plane + begin;
+	const float* lastRow = firstRow + (height - 1) * stride;
+
+	PixelState states[planeColumnBlock / 4];
+	__m256d edges[planeColumnBlock / 4];
+	for (int32_t i = 0; i < count; i++)
+	{
+		const __m256d first = loadFloats(firstRow + 4 * i);
+		states[i] = PixelState{ first, first, first };
+		edges[i] = loadFloats(lastRow + 4 * i);
+	}
+
+	for (int32_t y = 0; y < height; y++)
+	{
+		float* row = firstRow + y * stride;
+		for (int32_t i = 0; i < count; i++)
+			storeFloats(row + 4 * i, step(states[i], loadFloats(row + 4 * i), filter));
+	}
+
+	for (int32_t y = height - 1; y >= 0; y--)
+	{
+		float* row = firstRow + y * stride;
+		for (int32_t i = 0; i < count; i++)
+			storeFloats(row + 4 * i, y == height - 1 ? reverse(states[i], edges[i], filter) : step(states[i], loadFloats(row + 4 * i), filter));
+	}
+
+	blurPlaneColumnsScalar(plane, stride, height, begin + 4 * count, end, gaussian);
+}
+
+#endif
+
+void gaussianBlur(ConstBitmapView source, BitmapView destination, float sigma, ThreadPool* pool)
+{
+	if (!(sigma >= 0.5f) || !std::isfinite(sigma))
+		throw std::runtime_error("Sigma has to be at least 0.5.");
+	if (source.width() != destination.width() || source.height() != destination.height())
+		throw std::runtime_error("Bitmap sizes don't match.");
+
+	const int32_t width = source.width();
+	const int32_t height = source.height();
+	if (width == 0 || height == 0)
+		return;
+
+	const RecursiveGaussian filter = recursiveGaussian(sigma);
+	auto blurRow = blurRowScalar;
+	auto blurColumns = blurColumnsScalar;
+#ifdef BITMAP_X86
+	if (simdLevel() == SimdLevel::Avx2)
+	{
+		blurRow = blurRowAvx2;
+		blurColumns = blurColumnsAvx2;
+	}
+#endif
+
+	Buffer<float> rows(4 * static_cast<size_t>(width) * height, BufferAllocator<float>(destination.allocator()));
+	parallelFor(pool, 0, height, 0, [&](int32_t firstRow, int32_t lastRow) {
+		for (int32_t y = firstRow; y < lastRow; y++)
+			blurRow(source.row(y), rows.data() + 4 * static_cast<size_t>(width) * y, width, filter);
+	});
+
+	const int32_t blocks = (width + columnBlock - 1) / columnBlock;
+	parallelFor(pool, 0, blocks, 0, [&](int32_t firstBlock, int32_t lastBlock) {
+		for (int32_t block = firstBlock; block < lastBlock; block++)
+			blurColumns(rows.data(), destination, block * columnBlock, std::min((block + 1) * columnBlock, width), filter);
+	});
+}
+
+void gaussianBlur(const FloatImage& source, FloatImage& destination, float sigma, ThreadPool* pool)
+{
+	if (!(sigma >= 0.5f) || !std::isfinite(sigma))
+		throw std::runtime_error("Sigma has to be at least 0.5.");
+	if (source.width() != destination.width() || source.height() != destination.height())
+		throw std::runtime_error("Image sizes don't match.");
+
+	const int32_t width = source.width();
+	const int32_t height = source.height();
+	if (width == 0 || height == 0)
+		return;
+
+	const RecursiveGaussian filter = recursiveGaussian(sigma);
+	auto blurRow = blurPlaneRowScalar;
+	auto blurPlaneColumns = blurPlaneColumnsScalar;
+#ifdef BITMAP_X86
+	if (simdLevel() == SimdLevel::Avx2)
+	{
+		blurRow = blurPlaneRowAvx2;
+		blurPlaneColumns = blurPlaneColumnsAvx2;
+	}
+#endif
+
+	parallelFor(pool, 0, height, 0, [&](int32_t firstRow, int32_t lastRow) {
+		for (int32_t y = firstRow; y < lastRow; y++)
+		{
+			const float* const sourceRows[4] = { source.row(FloatImage::Red, y), source.row(FloatImage::Green, y), source.row(FloatImage::Blue, y), source.row(FloatImage::Alpha, y) };
+			float* const destinationRows[4] = { destination.row(FloatImage::Red, y), destination.row(FloatImage::Green, y), destination.row(FloatImage::Blue, y), destination.row(FloatImage::Alpha, y) };
+			blurRow(sourceRows, destinationRows, width, filter);
+		}
+	});
+
+	const int32_t blocks = (width + planeColumnBlock - 1) / planeColumnBlock;
+	parallelFor(pool, 0, FloatImage::channelCount * blocks, 0, [&](int32_t first, int32_t last) {
+		for (int32_t i = first; i < last; i++)
+		{
+			const int32_t block = i % blocks;
+			blurPlaneColumns(destination.row(i / blocks, 0), destination.stride(), height, block * planeColumnBlock, std::min((block + 1) * planeColumnBlock, width), filter);
+		}
+	});
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+
+#include "Bitmap.h"
+#include "FloatImage.h"
+#include "ThreadPool.h"
+
+// Approximates a convolution of every channel, including alpha, with a Gaussian of the given standard deviation.
+// Pixels outside of the source are copies of the nearest edge pixel, like in convolve. Results are rounded to the
+// nearest integer.
+// The Gaussian is applied as a recursive filter running forwards and backwards over the rows and then over the
+// columns (Young and van Vliet), so the cost per pixel is the same for any sigma. Sigma has to be at least 0.5.
+// The result is within a level or two of a sampled Gaussian for sigmas above about 3. Below that the approximation
+// gets coarser and a convolution with a sampled kernel is more accurate.
+void gaussianBlur(ConstBitmapView source, BitmapView destination, float sigma, ThreadPool* pool = nullptr);
+
+// Same filter for float images, without clamping or rounding. Converting the result to a bitmap gives the same pixels
+// as blurring the bitmap. The source and destination can be the same image.
+void gaussianBlur(const FloatImage& source, FloatImage& destination, float sigma, ThreadPool* pool = nullptr);
@@ -0,0 +1,387 @@
+#include "HsvConversion.h"
+#include "intrinsics.h"
+#include <cmath>
+
+// RGB to HSV picks the formula of the hue by the largest channel with selects instead of branches. HSV to RGB uses the
+// form channel(n) = v - v * s * clamp(min(k, 4 - k), 0, 1) with k = (n + 6 * h) mod 6 and n = 5, 3, 1 for red, green and
+// blue, which gives the six sectors of the hue without branches. The SIMD versions do the same float operations in the
+// same order as the scalar ones.
+
+// Same results as minps and maxps, which return the second operand if either is NaN. std::min and std::max return the
+// first one, which would make NaN and infinite hues or factors give different colors depending on the path.
+static inline float minFloat(float a, float b)
+{
+	return a < b ? a : b;
+}
+
+static inline float maxFloat(float a, float b)
+{
+	return a > b ? a : b;
+}
+
+struct HsvAdjustment
+{
+	float hueShift;
+	float saturationFactor;
+	float valueFactor;
+};
+
+static ColorHsv rgbToHsvScalar(const Color& color)
+{
+	const float red = color.r / 255.f;
+	const float green = color.g / 255.f;
+	const float blue = color.b / 255.f;
+	const float max = maxFloat(red, maxFloat(green, blue));
+	const float min = minFloat(red, minFloat(green, blue));
+	const float delta = max - min;
+
+	float hue = 0;
+	if (delta != 0)
+	{
+		const bool isRed = max == red;
+		const bool isGreen = !isRed && max == green;
+		const float numerator = isRed ? green - blue : (isGreen ? blue - red : red - green);
+		const float offset = isRed ? 0.f : (isGreen ? 120.f : 240.f);
+		hue = 60.f * (numerator / delta) + offset;
+	}
+	if (hue < 0)
+		hue = hue + 360.f;
+
+	return ColorHsv{ hue / 360.f, max > 0 ? delta / max : 0.f, max };
+}
+
+// Rounded to the nearest integer. Written so NaN fails both comparisons and becomes 0 like with the max and min
+// instructions.
+static uint8_t toChannel(float value)
+{
+	const float scaled = value * 255.f + 0.5f;
+	return static_cast<uint8_t>(scaled > 0.f ? (scaled < 255.f ? scaled : 255.f) : 0.f);
+}
+
+static float sectorWeight(float n, float sector)
+{
+	float k = n + sector;
+	k = k >= 6.f ? k - 6.f : k;
+	return minFloat(maxFloat(minFloat(k, 4.f - k), 0.f), 1.f);
+}
+
+static Color hsvToRgbScalar(const ColorHsv& color, uint8_t alpha)
+{
+	const float sector = (color.h - std::floor(color.h)) * 6.f;
+	const float chroma = color.s * color.v;
+	return Color(
+		toChannel(color.v - chroma * sectorWeight(5.f, sector)),
+		toChannel(color.v - chroma * sectorWeight(3.f, sector)),
+		toChannel(color.v - chroma * sectorWeight(1.f, sector)),
+		alpha
+	);
+}
+
+static ColorHsv adjustScalar(ColorHsv color, const HsvAdjustment& adjustment)
+{
+	return ColorHsv{
+		color.h + adjustment.hueShift,
+		minFloat(maxFloat(color.s * adjustment.saturationFactor, 0.f), 1.f),
+		minFloat(maxFloat(color.v * adjustment.valueFactor, 0.f), 1.f)
+	};
+}
+
+static void rgbToHsvScalar(const Color* source, ColorHsv* destination, int32_t begin, int32_t end)
+{
+	for (int32_t x = begin; x < end; x++)
+		destination[x] = rgbToHsvScalar(source[x]);
+}
+
+static void hsvToRgbScalar(const ColorHsv* source, Color* destination, int32_t begin, int32_t end)
+{
+	for (int32_t x = begin; x < end; x++)
+		destination[x] = hsvToRgbScalar(source[x], 255);
+}
+
+static void adjustHsvScalar(Color* pixels, int32_t begin, int32_t end, const HsvAdjustment& adjustment)
+{
+	for (int32_t x = begin; x < end; x++)
+		pixels[x] = hsvToRgbScalar(adjustScalar(rgbToHsvScalar(pixels[x]), adjustment), pixels[x].a);
+}
+
+#ifdef BITMAP_X86
+
+// Hue, saturation and value of 4 pixels.
+struct HsvSse41
+{
+	__m128 h;
+	__m128 s;
+	__m128 v;
+};
+
+TARGET_SSE41 static inline HsvSse41 rgbToHsvSse41(__m128i pixels)
+{
+	const __m128i byteMask = _mm_set1_epi32(0xFF);
+	const __m128 scale = _mm_set1_ps(255.f);
+	const __m128 red = _mm_div_ps(_mm_cvtepi32_ps(_mm_srli_epi32(pixels, 24)), scale);
+	const __m128 green = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), byteMask)), scale);
+	const __m128 blue = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), byteMask)), scale);
+	const __m128 max = _mm_max_ps(red, _mm_max_ps(green, blue));
+	const __m128 min = _mm_min_ps(red, _mm_min_ps(green, blue));
+	const __m128 delta = _mm_sub_ps(max, min);
+	const __m128 zero = _mm_setzero_ps();
+
+	const __m128 isRed = _mm_cmpeq_ps(max, red);
+	const __m128 isGreen = _mm_andnot_ps(isRed, _mm_cmpeq_ps(max, green));
+	const __m128 numerator = _mm_blendv_ps(_mm_blendv_ps(_mm_sub_ps(red, green), _mm_sub_ps(blue, red), isGreen), _mm_sub_ps(green, blue), isRed);
+	const __m128 offset = _mm_blendv_ps(_mm_blendv_ps(_mm_set1_ps(240.f), _mm_set1_ps(120.f), isGreen), zero, isRed);
+	__m128 hue = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(60.f), _mm_div_ps(numerator, delta)), offset);
+	hue = _mm_and_ps(hue, _mm_cmpneq_ps(delta, zero));
+	hue = _mm_blendv_ps(hue, _mm_add_ps(hue, _mm_set1_ps(360.f)), _mm_cmplt_ps(hue, zero));
+
+	const __m128 saturation = _mm_and_ps(_mm_div_ps(delta, max), _mm_cmpgt_ps(max, zero));
+	return HsvSse41{ _mm_div_ps(hue, _mm_set1_ps(360.f)), saturation, max };
+}
+
+TARGET_SSE41 static inline __m128i toChannelsSse41(__m128 value)
+{
+	const __m128 scaled = _mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.f)), _mm_set1_ps(0.5f));
+	return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(scaled, _mm_setzero_ps()), _mm_set1_ps(255.f)));
+}
+
+TARGET_SSE41 static inline __m128 sectorWeightSse41(float n, __m128 sector)
+{
+	const __m128 six = _mm_set1_ps(6.f);
+	__m128 k = _mm_add_ps(_mm_set1_ps(n), sector);
+	k = _mm_blendv_ps(k, _mm_sub_ps(k, six), _mm_cmpge_ps(k, six));
+	const __m128 weight = _mm_min_ps(k, _mm_sub_ps(_mm_set1_ps(4.f), k));
+	return _mm_min_ps(_mm_max_ps(weight, _mm_setzero_ps()), _mm_set1_ps(1.f));
+}
+
+// The alphas are the lowest bytes of the lanes, everything else is ignored.
+TARGET_SSE41 static inline __m128i hsvToRgbSse41(const HsvSse41& color, __m128i alphas)
+{
+	const __m128 sector = _mm_mul_ps(_mm_sub_ps(color.h, _mm_floor_ps(color.h)), _mm_set1_ps(6.f));
+	const __m128 chroma = _mm_mul_ps(color.s, color.v);
+	const __m128i red = toChannelsSse41(_mm_sub_ps(color.v, _mm_mul_ps(chroma, sectorWeightSse41(5.f, sector))));
+	const __m128i green = toChannelsSse41(_mm_sub_ps(color.v, _mm_mul_ps(chroma, sectorWeightSse41(3.f, sector))));
+	const __m128i blue = toChannelsSse41(_mm_sub_ps(color.v, _mm_mul_ps(chroma, sectorWeightSse41(1.f, sector))));
+	return _mm_or_si128(
+		_mm_or_si128(_mm_slli_epi32(red, 24), _mm_slli_epi32(green, 16)),
+		_mm_or_si128(_mm_slli_epi32(blue, 8), _mm_and_si128(alphas, _mm_set1_epi32(0xFF)))
+	);
+}
+
+TARGET_SSE41 static void rgbToHsvSse41(const Color* source, ColorHsv* destination, int32_t begin, int32_t end)
+{
+	int32_t x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		const HsvSse41 color = rgbToHsvSse41(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x)));
+		float h[4], s[4], v[4];
+		_mm_storeu_ps(h, color.h);
+		_mm_storeu_ps(s, color.s);
+		_mm_storeu_ps(v, color.v);
+		for (int i = 0; i < 4; i++)
+			destination[x + i] = ColorHsv{ h[i], s[i], v[i] };
+	}
+	rgbToHsvScalar(source, destination, x, end);
+}
+
+TARGET_SSE41 static void hsvToRgbSse41(const ColorHsv* source, Color* destination, int32_t begin, int32_t end)
+{
+	int32_t x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		float h[4], s[4], v[4];
+		for (int i = 0; i < 4; i++)
+		{
+			h[i] = source[x + i].h;
+			s[i] = source[x + i].s;
+			v[i] = source[x + i].v;
+		}
+		const HsvSse41 color{ _mm_loadu_ps(h), _mm_loadu_ps(s), _mm_loadu_ps(v) };
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x), hsvToRgbSse41(color, _mm_set1_epi32(0xFF)));
+	}
+	hsvToRgbScalar(source, destination, x, end);
+}
+
+TARGET_SSE41 static void adjustHsvSse41(Color* pixels, int32_t begin, int32_t end, const HsvAdjustment& adjustment)
+{
+	const __m128 hueShift = _mm_set1_ps(adjustment.hueShift);
+	const __m128 saturationFactor = _mm_set1_ps(adjustment.saturationFactor);
+	const __m128 valueFactor = _mm_set1_ps(adjustment.valueFactor);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	int32_t x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		const __m128i colors = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + x));
+		HsvSse41 color = rgbToHsvSse41(colors);
+		color.h = _mm_add_ps(color.h, hueShift);
+		color.s = _mm_min_ps(_mm_max_ps(_mm_mul_ps(color.s, saturationFactor), zero), one);
+		color.v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(color.v, valueFactor), zero), one);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + x), hsvToRgbSse41(color, colors));
+	}
+	adjustHsvScalar(pixels, x, end, adjustment);
+}
+
+// Same as the SSE4.1 versions with 8 pixels.
+struct HsvAvx2
+{
+	__m256 h;
+	__m256 s;
+	__m256 v;
+};
+
+TARGET_AVX2 static inline HsvAvx2 rgbToHsvAvx2(__m256i pixels)
+{
+	const __m256i byteMask = _mm256_set1_epi32(0xFF);
+	const __m256 scale = _mm256_set1_ps(255.f);
+	const __m256 red = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(pixels, 24)), scale);
+	const __m256 green = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), byteMask)), scale);
+	const __m256 blue = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask)), scale);
+	const __m256 max = _mm256_max_ps(red, _mm256_max_ps(green, blue));
+	const __m256 min = _mm256_min_ps(red, _mm256_min_ps(green, blue));
+	const __m256 delta = _mm256_sub_ps(max, min);
+	const __m256 zero = _mm256_setzero_ps();
+
+	const __m256 isRed = _mm256_cmp_ps(max, red, _CMP_EQ_OQ);
+	const __m256 isGreen = _mm256_andnot_ps(isRed, _mm256_cmp_ps(max, green, _CMP_EQ_OQ));
+	const __m256 numerator = _mm256_blendv_ps(_mm256_blendv_ps(_mm256_sub_ps(red, green), _mm256_sub_ps(blue, red), isGreen), _mm256_sub_ps(green, blue), isRed);
+	const __m256 offset = _mm256_blendv_ps(_mm256_blendv_ps(_mm256_set1_ps(240.f), _mm256_set1_ps(120.f), isGreen), zero, isRed);
+	__m256 hue = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(60.f), _mm256_div_ps(numerator, delta)), offset);
+	hue = _mm256_and_ps(hue, _mm256_cmp_ps(delta, zero, _CMP_NEQ_UQ));
+	hue = _mm256_blendv_ps(hue, _mm256_add_ps(hue, _mm256_set1_ps(360.f)), _mm256_cmp_ps(hue, zero, _CMP_LT_OQ));
+
+	const __m256 saturation = _mm256_and_ps(_mm256_div_ps(delta, max), _mm256_cmp_ps(max, zero, _CMP_GT_OQ));
+	return HsvAvx2{ _mm256_div_ps(hue, _mm256_set1_ps(360.f)), saturation, max };
+}
+
+TARGET_AVX2 static inline __m256i toChannelsAvx2(__m256 value)
+{
+	const __m256 scaled = _mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(255.f)), _mm256_set1_ps(0.5f));
+	return _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(scaled, _mm256_setzero_ps()), _mm256_set1_ps(255.f)));
+}
+
+TARGET_AVX2 static inline __m256 sectorWeightAvx2(float n, __m256 sector)
+{
+	const __m256 six = _mm256_set1_ps(6.f);
+	__m256 k = _mm256_add_ps(_mm256_set1_ps(n), sector);
+	k = _mm256_blendv_ps(k, _mm256_sub_ps(k, six), _mm256_cmp_ps(k, six, _CMP_GE_OQ));
+	const __m256 weight = _mm256_min_ps(k, _mm256_sub_ps(_mm256_set1_ps(4.f), k));
+	return _mm256_min_ps(_mm256_max_ps(weight, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+}
+
+TARGET_AVX2 static inline __m256i hsvToRgbAvx2(const HsvAvx2& color, __m256i alphas)
+{
+	const __m256 sector = _mm256_mul_ps(_mm256_sub_ps(color.h, _mm256_floor_ps(color.h)), _mm256_set1_ps(6.f));
+	const __m256 chroma = _mm256_mul_ps(color.s, color.v);
+	const __m256i red = toChannelsAvx2(_mm256_sub_ps(color.v, _mm256_mul_ps(chroma, sectorWeightAvx2(5.f, sector))));
+	const __m256i green = toChannelsAvx2(_mm256_sub_ps(color.v, _mm256_mul_ps(chroma, sectorWeightAvx2(3.f, sector))));
+	const __m256i blue = toChannelsAvx2(_mm256_sub_ps(color.v, _mm256_mul_ps(chroma, sectorWeightAvx2(1.f, sector))));
+	return _mm256_or_si256(
+		_mm256_or_si256(_mm256_slli_epi32(red, 24), _mm256_slli_epi32(green, 16)),
+		_mm256_or_si256(_mm256_slli_epi32(blue, 8), _mm256_and_si256(alphas, _mm256_set1_epi32(0xFF)))
+	);
+}
+
+TARGET_AVX2 static void rgbToHsvAvx2(const Color* source, ColorHsv* destination, int32_t begin, int32_t end)
+{
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		const HsvAvx2 color = rgbToHsvAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + x)));
+		float h[8], s[8], v[8];
+		_mm256_storeu_ps(h, color.h);
+		_mm256_storeu_ps(s, color.s);
+		_mm256_storeu_ps(v, color.v);
+		for (int i = 0; i < 8; i++)
+			destination[x + i] = ColorHsv{ h[i], s[i], v[i] };
+	}
+	rgbToHsvSse41(source, destination, x, end);
+}
+
+TARGET_AVX2 static void hsvToRgbAvx2(const ColorHsv* source, Color* destination, int32_t begin, int32_t end)
+{
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		float h[8], s[8], v[8];
+		for (int i = 0; i < 8; i++)
+		{
+			h[i] = source[x + i].h;
+			s[i] = source[x + i].s;
+			v[i] = source[x + i].v;
+		}
+		const HsvAvx2 color{ _mm256_loadu_ps(h), _mm256_loadu_ps(s), _mm256_loadu_ps(v) };
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + x), hsvToRgbAvx2(color, _mm256_set1_epi32(0xFF)));
+	}
+	hsvToRgbSse41(source, destination, x, end);
+}
+
+TARGET_AVX2 static void adjustHsvAvx2(Color* pixels, int32_t begin, int32_t end, const HsvAdjustment& adjustment)
+{
+	const __m256 hueShift = _mm256_set1_ps(adjustment.hueShift);
+	const __m256 saturationFactor = _mm256_set1_ps(adjustment.saturationFactor);
+	const __m256 valueFactor = _mm256_set1_ps(adjustment.valueFactor);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.f);
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		const __m256i colors = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + x));
+		HsvAvx2 color = rgbToHsvAvx2(colors);
+		color.h = _mm256_add_ps(color.h, hueShift);
+		color.s = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(color.s, saturationFactor), zero), one);
+		color.v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(color.v, valueFactor), zero), one);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + x), hsvToRgbAvx2(color, colors));
+	}
+	adjustHsvSse41(pixels, x, end, adjustment);
+}
+
+#endif
+
+void rgbToHsv(const Color* source, ColorHsv* destination, int32_t count)
+{
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		return rgbToHsvAvx2(source, destination, 0, count);
+	case SimdLevel::Sse41:
+		return rgbToHsvSse41(source, destination, 0, count);
+	default:
+		break;
+	}
+#endif
+	rgbToHsvScalar(source, destination, 0, count);
+}
+
+void hsvToRgb(const ColorHsv* source, Color* destination, int32_t count)
+{
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		return hsvToRgbAvx2(source, destination, 0, count);
+	case SimdLevel::Sse41:
+		return hsvToRgbSse41(source, destination, 0, count);
+	default:
+		break;
+	}
+#endif
+	hsvToRgbScalar(source, destination, 0, count);
+}
+
+void adjustHsv(Color* pixels, int32_t count, float hueShift, float saturationFactor, float valueFactor)
+{
+	const HsvAdjustment adjustment{ hueShift, saturationFactor, valueFactor };
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		return adjustHsvAvx2(pixels, 0, count, adjustment);
+	case SimdLevel::Sse41:
+		return adjustHsvSse41(pixels, 0, count, adjustment);
+	default:
+		break;
+	}
+#endif
+	adjustHsvScalar(pixels, 0, count, adjustment);
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+
+#include "Color.h"
+
+// Conversions between arrays of Color and ColorHsv, computed without branches for 8 pixels at a time with AVX2 or 4 with
+// SSE4.1. The per pixel rgbToHsv and hsvToRgb use the same code, so the results are identical, even for NaN or infinite
+// inputs.
+// Hue, saturation and value are in [0, 1]. Hues outside of that range wrap around when converting to colors, and the
+// color channels are rounded to the nearest integer. Colors made from HSV are opaque.
+
+void rgbToHsv(const Color* source, ColorHsv* destination, int32_t count);
+void hsvToRgb(const ColorHsv* source, Color* destination, int32_t count);
+
+// Converts the pixels to HSV, adds hueShift to the hue, multiplies the saturation and value with the factors, clamping
+// them to [0, 1], and converts back in place. The alpha is kept. Nothing is stored in between, so this is about as
+// fast as a single conversion.
+void adjustHsv(Color* pixels, int32_t count, float hueShift, float saturationFactor, float valueFactor);
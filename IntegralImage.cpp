@@ -0,0 +1,259 @@
+#include "IntegralImage.h"
+#include <algorithm>
+#include <stdexcept>
+
+// Every row is a running sum of the pixels in the row added to the entries of the row above. Updating from a column
+// other than zero restores the running sum from the difference of the two rows at that column.
+
+static void accumulateRowScalar(const Color* pixels, const ChannelSums* above, ChannelSums* current, int32_t begin, int32_t end)
+{
+	ChannelSums running{ current[begin].a - above[begin].a, current[begin].b - above[begin].b, current[begin].g - above[begin].g, current[begin].r - above[begin].r };
+	for (int32_t x = begin; x < end; x++)
+	{
+		running.a += pixels[x].a;
+		running.b += pixels[x].b;
+		running.g += pixels[x].g;
+		running.r += pixels[x].r;
+		current[x + 1] = ChannelSums{ above[x + 1].a + running.a, above[x + 1].b + running.b, above[x + 1].g + running.g, above[x + 1].r + running.r };
+	}
+}
+
+static void accumulateSquaredRowScalar(const Color* pixels, const ChannelSquaredSums* above, ChannelSquaredSums* current, int32_t begin, int32_t end)
+{
+	ChannelSquaredSums running{ current[begin].a - above[begin].a, current[begin].b - above[begin].b, current[begin].g - above[begin].g, current[begin].r - above[begin].r };
+	for (int32_t x = begin; x < end; x++)
+	{
+		running.a += pixels[x].a * pixels[x].a;
+		running.b += pixels[x].b * pixels[x].b;
+		running.g += pixels[x].g * pixels[x].g;
+		running.r += pixels[x].r * pixels[x].r;
+		current[x + 1] = ChannelSquaredSums{ above[x + 1].a + running.a, above[x + 1].b + running.b, above[x + 1].g + running.g, above[x + 1].r + running.r };
+	}
+}
+
+#ifdef BITMAP_X86
+
+// ChannelSums has the same layout as the four 32 bit lanes the bytes of a Color are widened to.
+TARGET_SSE41 static void accumulateRowSse41(const Color* pixels, const ChannelSums* above, ChannelSums* current, int32_t begin, int32_t end)
+{
+	__m128i running = _mm_sub_epi32(
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(current + begin)),
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(above + begin))
+	);
+	for (int32_t x = begin; x < end; x++)
+	{
+		running = _mm_add_epi32(running, _mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(pixels[x].value))));
+		const __m128i sums = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x + 1)), running);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(current + x + 1), sums);
+	}
+}
+
+TARGET_SSE41 static void accumulateSquaredRowSse41(const Color* pixels, const ChannelSquaredSums* above, ChannelSquaredSums* current, int32_t begin, int32_t end)
+{
+	const __m128i* aboveLanes = reinterpret_cast<const __m128i*>(above);
+	__m128i* currentLanes = reinterpret_cast<__m128i*>(current);
+	// Alpha and blue in the low half, green and red in the high half.
+	__m128i runningLow = _mm_sub_epi64(_mm_loadu_si128(currentLanes + 2 * begin), _mm_loadu_si128(aboveLanes + 2 * begin));
+	__m128i runningHigh = _mm_sub_epi64(_mm_loadu_si128(currentLanes + 2 * begin + 1), _mm_loadu_si128(aboveLanes + 2 * begin + 1));
+	for (int32_t x = begin; x < end; x++)
+	{
+		const __m128i channels = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(pixels[x].value)));
+		const __m128i squares = _mm_mullo_epi32(channels, channels);
+		runningLow = _mm_add_epi64(runningLow, _mm_cvtepu32_epi64(squares));
+		runningHigh = _mm_add_epi64(runningHigh, _mm_cvtepu32_epi64(_mm_srli_si128(squares, 8)));
+		_mm_storeu_si128(currentLanes + 2 * (x + 1), _mm_add_epi64(_mm_loadu_si128(aboveLanes + 2 * (x + 1)), runningLow));
+		_mm_storeu_si128(currentLanes + 2 * (x + 1) + 1, _mm_add_epi64(_mm_loadu_si128(aboveLanes + 2 * (x + 1) + 1), runningHigh));
+	}
+}
+
+#endif
+
+IntegralImage::IntegralImage(ConstBitmapView bitmap, bool squaredSums)
+	:m_sums((static_cast<size_t>(bitmap.width()) + 1) * (static_cast<size_t>(bitmap.height()) + 1), ChannelSums{ 0, 0, 0, 0 }, BufferAllocator<ChannelSums>(bitmap.allocator()))
+	, m_squaredSums(BufferAllocator<ChannelSquaredSums>(bitmap.allocator()))
+	, m_width(bitmap.width())
+	, m_height(bitmap.height())
+{
+	if (squaredSums)
+		m_squaredSums.resize(m_sums.size(), ChannelSquaredSums{ 0, 0, 0, 0 });
+	update(bitmap);
+}
+
+void IntegralImage::update(ConstBitmapView bitmap, int32_t left, int32_t top)
+{
+	if (bitmap.width() != m_width || bitmap.height() != m_height)
+		throw std::runtime_error("Bitmap size doesn't match the integral image.");
+	if (left < 0 || top < 0 || left > m_width || top > m_height)
+		throw std::runtime_error("Update position out of range.");
+
+#ifdef BITMAP_X86
+	const bool sse41 = simdLevel() >= SimdLevel::Sse41;
+#else
+	const bool sse41 = false;
+#endif
+
+	for (int32_t y = top; y < m_height; y++)
+	{
+		const ChannelSums* above = &m_sums[index(0, y)];
+		ChannelSums* current = &m_sums[index(0, y + 1)];
+#ifdef BITMAP_X86
+		if (sse41)
+			accumulateRowSse41(bitmap.row(y), above, current, left, m_width);
+		else
+#endif
+			accumulateRowScalar(bitmap.row(y), above, current, left, m_width);
+
+		if (!hasSquaredSums())
+			continue;
+
+		const ChannelSquaredSums* squaredAbove = &m_squaredSums[index(0, y)];
+		ChannelSquaredSums* squaredCurrent = &m_squaredSums[index(0, y + 1)];
+#ifdef BITMAP_X86
+		if (sse41)
+			accumulateSquaredRowSse41(bitmap.row(y), squaredAbove, squaredCurrent, left, m_width);
+		else
+#endif
+			accumulateSquaredRowScalar(bitmap.row(y), squaredAbove, squaredCurrent, left, m_width);
+	}
+}
+
+ChannelSums IntegralImage::sum(int32_t left, int32_t top, int32_t right, int32_t bottom) const
+{
+	const ChannelSums& topLeft = m_sums[index(left, top)];
+	const ChannelSums& topRight = m_sums[index(right, top)];
+	const ChannelSums& bottomLeft = m_sums[index(left, bottom)];
+	const ChannelSums& bottomRight = m_sums[index(right, bottom)];
+	return ChannelSums{
+		bottomRight.a - bottomLeft.a - topRight.a + topLeft.a,
+		bottomRight.b - bottomLeft.b - topRight.b + topLeft.b,
+		bottomRight.g - bottomLeft.g - topRight.g + topLeft.g,
+		bottomRight.r - bottomLeft.r - topRight.r + topLeft.r
+	};
+}
+
+ChannelSquaredSums IntegralImage::squaredSum(int32_t left, int32_t top, int32_t right, int32_t bottom) const
+{
+	if (!hasSquaredSums())
+		throw std::runtime_error("The integral image has no squared sums.");
+
+	const ChannelSquaredSums& topLeft = m_squaredSums[index(left, top)];
+	const ChannelSquaredSums& topRight = m_squaredSums[index(right, top)];
+	const ChannelSquaredSums& bottomLeft = m_squaredSums[index(left, bottom)];
+	const ChannelSquaredSums& bottomRight = m_squaredSums[index(right, bottom)];
+	return ChannelSquaredSums{
+		bottomRight.a - bottomLeft.a - topRight.a + topLeft.a,
+		bottomRight.b - bottomLeft.b - topRight.b + topLeft.b,
+		bottomRight.g - bottomLeft.g - topRight.g + topLeft.g,
+		bottomRight.r - bottomLeft.r - topRight.r + topLeft.r
+	};
+}
+
+Color IntegralImage::mean(int32_t left, int32_t top, int32_t right, int32_t bottom) const
+{
+	const ChannelSums sums = sum(left, top, right, bottom);
+	const uint64_t area = static_cast<uint64_t>(right - left) * static_cast<uint64_t>(bottom - top);
+	if (area == 0)
+		return Color(0);
+	return Color(
+		static_cast<uint8_t>((sums.r + area / 2) / area),
+		static_cast<uint8_t>((sums.g + area / 2) / area),
+		static_cast<uint8_t>((sums.b + area / 2) / area),
+		static_cast<uint8_t>((sums.a + area / 2) / area)
+	);
+}
+
+ChannelVariances IntegralImage::variance(int32_t left, int32_t top, int32_t right, int32_t bottom) const
+{
+	const ChannelSquaredSums squares = squaredSum(left, top, right, bottom);
+	const ChannelSums sums = sum(left, top, right, bottom);
+	const double area = static_cast<double>(right - left) * static_cast<double>(bottom - top);
+	if (area == 0)
+		return ChannelVariances{ 0, 0, 0, 0 };
+
+	const auto channelVariance = [area](uint64_t squareSum, uint32_t sum) {
+		const double mean = sum / area;
+		return static_cast<float>(std::max(squareSum / area - mean * mean, 0.0));
+	};
+	return ChannelVariances{
+		channelVariance(squares.a, sums.a),
+		channelVariance(squares.b, sums.b),
+		channelVariance(squares.g, sums.g),
+		channelVariance(squares.r, sums.r)
+	};
+}
+
+// The window of a pixel near an edge reaches past the image by up to radius pixels on each side. Those pixels are
+// copies of the edge row or column, so the clamped window sum is the sum of the part inside of the image plus the
+// edge rows and columns (and corner pixels) weighted by how far the window sticks out.
+void boxBlur(const IntegralImage& integral, BitmapView destination, int32_t radius, ThreadPool* pool)
+{
+	const int32_t width = integral.width();
+	const int32_t height = integral.height();
+	if (destination.width() != width || destination.height() != height)
+		throw std::runtime_error("Bitmap size doesn't match the integral image.");
+	if (radius < 0 || radius > (1 << 27))
+		throw std::runtime_error("Invalid radius.");
+	if (width == 0 || height == 0)
+		return;
+
+	const uint64_t diameter = 2 * static_cast<uint64_t>(radius) + 1;
+	if (std::min<uint64_t>(diameter, width) * std::min<uint64_t>(diameter, height) > IntegralImage::maxExactArea)
+		throw std::runtime_error("Radius too large for the integral image.");
+	const uint64_t area = diameter * diameter;
+
+	parallelFor(pool, 0, height, 0, [&](int32_t firstRow, int32_t lastRow) {
+		for (int32_t y = firstRow; y < lastRow; y++)
+		{
+			const int32_t top = std::max(y - radius, 0);
+			const int32_t bottom = std::min(y + radius, height - 1) + 1;
+			const uint64_t extraTop = static_cast<uint64_t>(std::max(radius - y, 0));
+			const uint64_t extraBottom = static_cast<uint64_t>(std::max(y + radius - (height - 1), 0));
+			Color* row = destination.row(y);
+
+			for (int32_t x = 0; x < width; x++)
+			{
+				const int32_t left = std::max(x - radius, 0);
+				const int32_t right = std::min(x + radius, width - 1) + 1;
+				const uint64_t extraLeft = static_cast<uint64_t>(std::max(radius - x, 0));
+				const uint64_t extraRight = static_cast<uint64_t>(std::max(x + radius - (width - 1), 0));
+
+				const ChannelSums inside = integral.sum(left, top, right, bottom);
+				uint64_t total[4]{ inside.a, inside.b, inside.g, inside.r };
+				const auto add = [&total](const ChannelSums& sums, uint64_t weight) {
+					total[0] += sums.a * weight;
+					total[1] += sums.b * weight;
+					total[2] += sums.g * weight;
+					total[3] += sums.r * weight;
+				};
+
+				if (extraLeft)
+					add(integral.sum(0, top, 1, bottom), extraLeft);
+				if (extraRight)
+					add(integral.sum(width - 1, top, width, bottom), extraRight);
+				if (extraTop)
+				{
+					add(integral.sum(left, 0, right, 1), extraTop);
+					if (extraLeft)
+						add(integral.sum(0, 0, 1, 1), extraTop * extraLeft);
+					if (extraRight)
+						add(integral.sum(width - 1, 0, width, 1), extraTop * extraRight);
+				}
+				if (extraBottom)
+				{
+					add(integral.sum(left, height - 1, right, height), extraBottom);
+					if (extraLeft)
+						add(integral.sum(0, height - 1, 1, height), extraBottom * extraLeft);
+					if (extraRight)
+						add(integral.sum(width - 1, height - 1, width, height), extraBottom * extraRight);
+				}
+
+				row[x] = Color(
+					static_cast<uint8_t>((total[3] + area / 2) / area),
+					static_cast<uint8_t>((total[2] + area / 2) / area),
+					static_cast<uint8_t>((total[1] + area / 2) / area),
+					static_cast<uint8_t>((total[0] + area / 2) / area)
+				);
+			}
+		}
+	});
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Bitmap.h"
+#include "ThreadPool.h"
+
+// Per channel sums, ordered like the channels of a Color in memory.
+struct ChannelSums
+{
+	uint32_t a;
+	uint32_t b;
+	uint32_t g;
+	uint32_t r;
+};
+
+struct ChannelSquaredSums
+{
+	uint64_t a;
+	uint64_t b;
+	uint64_t g;
+	uint64_t r;
+};
+
+struct ChannelVariances
+{
+	float a;
+	float b;
+	float g;
+	float r;
+};
+
+// Summed-area table of a bitmap. The entry at (x, y) holds the sums of all pixels above and left of it, so the sum
+// of any rectangle takes four lookups regardless of its size.
+// The sums are 32 bit and wrap around, which cancels out when taking the differences. Rectangle sums are therefore
+// exact for rectangles of up to maxExactArea pixels. The squared sums needed for the variance are 64 bit and only
+// computed if requested.
+class IntegralImage
+{
+public:
+	static constexpr uint32_t maxExactArea = UINT32_MAX / 255;
+
+	// The sums are stored in buffers from the allocator of the bitmap.
+	explicit IntegralImage(ConstBitmapView bitmap, bool squaredSums = false);
+
+	// Recomputes the sums after pixels of the bitmap changed. Only the entries right of left and below top are
+	// touched, so changes near the bottom right corner are cheap.
+	void update(ConstBitmapView bitmap, int32_t left = 0, int32_t top = 0);
+
+	int32_t width() const;
+	int32_t height() const;
+	bool hasSquaredSums() const;
+
+	// The rectangle is [left, right) x [top, bottom) and has to lie inside of the image.
+	ChannelSums sum(int32_t left, int32_t top, int32_t right, int32_t bottom) const;
+	ChannelSquaredSums squaredSum(int32_t left, int32_t top, int32_t right, int32_t bottom) const;
+	// Rounded to the nearest integer.
+	Color mean(int32_t left, int32_t top, int32_t right, int32_t bottom) const;
+	// Population variance. Requires the squared sums.
+	ChannelVariances variance(int32_t left, int32_t top, int32_t right, int32_t bottom) const;
+
+private:
+	size_t index(int32_t x, int32_t y) const;
+
+	// (width + 1) * (height + 1) entries, the first row and column are zero.
+	Buffer<ChannelSums> m_sums;
+	Buffer<ChannelSquaredSums> m_squaredSums;
+	int32_t m_width;
+	int32_t m_height;
+};
+
+// Replaces every channel of every pixel with the rounded mean of the (2 * radius + 1)^2 window around it. Pixels outside
+// of the image are copies of the nearest edge pixel. The cost per pixel doesn't depend on the radius.
+void boxBlur(const IntegralImage& integral, BitmapView destination, int32_t radius, ThreadPool* pool = nullptr);
+
+inline int32_t IntegralImage::width() const
+{
+	return m_width;
+}
+
+inline int32_t IntegralImage::height() const
+{
+	return m_height;
+}
+
+inline bool IntegralImage::hasSquaredSums() const
+{
+	return !m_squaredSums.empty();
+}
+
+inline size_t IntegralImage::index(int32_t x, int32_t y) const
+{
+	return static_cast<size_t>(y) * (static_cast<size_t>(m_width) + 1) + x;
+}
@@ -0,0 +1,192 @@
+#include "LookupTable.h"
+#include "intrinsics.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Bit position of each channel in Color::value.
+static constexpr int channelShifts[LookupTable::channelCount] = { 24, 16, 8, 0 };
+
+static uint8_t roundToByte(float value)
+{
+	return static_cast<uint8_t>(std::clamp(value, 0.f, 255.f) + 0.5f);
+}
+
+LookupTable::LookupTable()
+{
+	for (int c = 0; c < channelCount; c++)
+	{
+		for (int v = 0; v < 256; v++)
+			m_values[c][v] = static_cast<uint8_t>(v);
+		updateShifted(static_cast<Channel>(c));
+	}
+}
+
+LookupTable& LookupTable::gamma(float gamma)
+{
+	if (!(gamma > 0) || !std::isfinite(gamma))
+		throw std::runtime_error("Invalid gamma.");
+
+	const float exponent = 1.f / gamma;
+	transformColorChannels([exponent](uint8_t value) {
+		return roundToByte(255.f * std::pow(value / 255.f, exponent));
+	});
+	return *this;
+}
+
+LookupTable& LookupTable::levels(uint8_t inputBlack, uint8_t inputWhite, float gamma, uint8_t outputBlack, uint8_t outputWhite)
+{
+	if (inputWhite <= inputBlack)
+		throw std::runtime_error("The input white point has to be above the black point.");
+	if (!(gamma > 0) || !std::isfinite(gamma))
+		throw std::runtime_error("Invalid gamma.");
+
+	const float exponent = 1.f / gamma;
+	transformColorChannels([=](uint8_t value) {
+		const float normalized = std::clamp((value - inputBlack) / static_cast<float>(inputWhite - inputBlack), 0.f, 1.f);
+		return roundToByte(outputBlack + std::pow(normalized, exponent) * (outputWhite - outputBlack));
+	});
+	return *this;
+}
+
+LookupTable& LookupTable::curve(const std::vector<CurvePoint>& points)
+{
+	if (points.empty())
+		throw std::runtime_error("A curve needs at least one point.");
+	for (size_t i = 1; i < points.size(); i++)
+	{
+		if (points[i].input <= points[i - 1].input)
+			throw std::runtime_error("The points of a curve have to be sorted by input.");
+	}
+
+	transformColorChannels([&points](uint8_t value) {
+		if (value <= points.front().input)
+			return points.front().output;
+		if (value >= points.back().input)
+			return points.back().output;
+
+		size_t i = 1;
+		while (points[i].input < value)
+			i++;
+		const CurvePoint& left = points[i - 1];
+		const CurvePoint& right = points[i];
+		const float t = (value - left.input) / static_cast<float>(right.input - left.input);
+		return roundToByte(left.output + t * (right.output - left.output));
+	});
+	return *this;
+}
+
+LookupTable& LookupTable::threshold(uint8_t level)
+{
+	transformColorChannels([level](uint8_t value) {
+		return static_cast<uint8_t>(value >= level ? 255 : 0);
+	});
+	return *this;
+}
+
+LookupTable& LookupTable::invert()
+{
+	transformColorChannels([](uint8_t value) {
+		return static_cast<uint8_t>(255 - value);
+	});
+	return *this;
+}
+
+LookupTable& LookupTable::transform(Channel channel, const std::function<uint8_t(uint8_t)>& function)
+{
+	for (uint8_t& value : m_values[channel])
+		value = function(value);
+	updateShifted(channel);
+	return *this;
+}
+
+LookupTable& LookupTable::then(const LookupTable& table)
+{
+	for (int c = 0; c < channelCount; c++)
+	{
+		for (uint8_t& value : m_values[c])
+			value = table.m_values[c][value];
+		updateShifted(static_cast<Channel>(c));
+	}
+	return *this;
+}
+
+void LookupTable::transformColorChannels(const std::function<uint8_t(uint8_t)>& function)
+{
+	// The function only depends on the value, so it is evaluated once per value instead of once per entry.
+	uint8_t mapped[256];
+	for (int v = 0; v < 256; v++)
+		mapped[v] = function(static_cast<uint8_t>(v));
+
+	for (int c = Red; c <= Blue; c++)
+	{
+		for (uint8_t& value : m_values[c])
+			value = mapped[value];
+		updateShifted(static_cast<Channel>(c));
+	}
+}
+
+void LookupTable::updateShifted(Channel channel)
+{
+	for (int v = 0; v < 256; v++)
+		m_shifted[channel][v] = static_cast<uint32_t>(m_values[channel][v]) << channelShifts[channel];
+}
+
+using ShiftedTables = uint32_t[LookupTable::channelCount][256];
+
+static void applyRowScalar(const ShiftedTables& tables, const Color* source, Color* destination, int32_t begin, int32_t end)
+{
+	for (int32_t x = begin; x < end; x++)
+	{
+		const uint32_t value = source[x].value;
+		destination[x] = Color(tables[0][value >> 24] | tables[1][(value >> 16) & 0xFF] | tables[2][(value >> 8) & 0xFF] | tables[3][value & 0xFF]);
+	}
+}
+
+#ifdef BITMAP_X86
+
+// Gathers the four channels of 8 pixels at once. About 1.5 times faster than the scalar loop, which beats splitting
+// the tables into 16 byte pieces for pshufb.
+TARGET_AVX2 static void applyRowAvx2(const ShiftedTables& tables, const Color* source, Color* destination, int32_t begin, int32_t end)
+{
+	const __m256i byteMask = _mm256_set1_epi32(0xFF);
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + x));
+		const __m256i red = _mm256_i32gather_epi32(reinterpret_cast<const int*>(tables[0]), _mm256_srli_epi32(pixels, 24), 4);
+		const __m256i green = _mm256_i32gather_epi32(reinterpret_cast<const int*>(tables[1]), _mm256_and_si256(_mm256_srli_epi32(pixels, 16), byteMask), 4);
+		const __m256i blue = _mm256_i32gather_epi32(reinterpret_cast<const int*>(tables[2]), _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask), 4);
+		const __m256i alpha = _mm256_i32gather_epi32(reinterpret_cast<const int*>(tables[3]), _mm256_and_si256(pixels, byteMask), 4);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + x), _mm256_or_si256(_mm256_or_si256(red, green), _mm256_or_si256(blue, alpha)));
+	}
+	applyRowScalar(tables, source, destination, x, end);
+}
+
+#endif
+
+static auto selectApplyRow()
+{
+#ifdef BITMAP_X86
+	if (simdLevel() == SimdLevel::Avx2)
+		return applyRowAvx2;
+#endif
+	return applyRowScalar;
+}
+
+void LookupTable::apply(Color* pixels, int32_t count) const
+{
+	selectApplyRow()(m_shifted, pixels, pixels, 0, count);
+}
+
+void LookupTable::apply(ConstBitmapView source, BitmapView destination, ThreadPool* pool) const
+{
+	if (source.width() != destination.width() || source.height() != destination.height())
+		throw std::runtime_error("Bitmap sizes don't match.");
+
+	const auto applyRow = selectApplyRow();
+	parallelFor(pool, 0, source.height(), 0, [&](int32_t firstRow, int32_t lastRow) {
+		for (int32_t y = firstRow; y < lastRow; y++)
+			applyRow(m_shifted, source.row(y), destination.row(y), 0, source.width());
+	});
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "BitmapView.h"
+#include "Color.h"
+#include "ThreadPool.h"
+
+// Point on a curve of a LookupTable.
+struct CurvePoint
+{
+	uint8_t input;
+	uint8_t output;
+};
+
+// Independent map from 256 values to 256 values for each channel. Tonal adjustments like gamma, levels and curves are
+// composed into the table, so any chain of them is applied to an image in a single pass with one lookup per channel.
+class LookupTable
+{
+public:
+	enum Channel
+	{
+		Red,
+		Green,
+		Blue,
+		Alpha
+	};
+	static constexpr int channelCount = 4;
+
+	// Maps every value to itself.
+	LookupTable();
+
+	// Each function composes another map after the ones already in the table and returns the table, so calls can be
+	// chained. They change red, green and blue and keep the alpha unless noted otherwise. Results are rounded.
+
+	// Raises the values in [0, 1] to the power 1 / gamma, so gammas above 1 brighten the midtones.
+	LookupTable& gamma(float gamma);
+	// Maps inputBlack to 0 and inputWhite to 1, clamping the values outside, applies the gamma like above and maps the
+	// result to [outputBlack, outputWhite].
+	LookupTable& levels(uint8_t inputBlack, uint8_t inputWhite, float gamma = 1.f, uint8_t outputBlack = 0, uint8_t outputWhite = 255);
+	// Piecewise linear through the points, which have to be sorted by strictly increasing input. Values before the
+	// first or after the last point get the output of that point.
+	LookupTable& curve(const std::vector<CurvePoint>& points);
+	// 255 for values of at least the level and 0 otherwise, for each channel on its own.
+	LookupTable& threshold(uint8_t level);
+	LookupTable& invert();
+	// Maps the values of a single channel, which may be the alpha, with the function.
+	LookupTable& transform(Channel channel, const std::function<uint8_t(uint8_t)>& function);
+	// Composes all channels of the other table after these.
+	LookupTable& then(const LookupTable& table);
+
+	uint8_t map(Channel channel, uint8_t value) const;
+
+	// Replaces every channel of the pixels with its mapped value. Uses AVX2 gathers when available, the scalar lookups
+	// are faster than anything SSE4.1 offers for 256 entry tables.
+	void apply(Color* pixels, int32_t count) const;
+	// The views have to be the same size and may be the same but mustn't overlap otherwise. With a pool the rows are
+	// split between the threads.
+	void apply(ConstBitmapView source, BitmapView destination, ThreadPool* pool = nullptr) const;
+
+private:
+	void transformColorChannels(const std::function<uint8_t(uint8_t)>& function);
+	void updateShifted(Channel channel);
+
+	uint8_t m_values[channelCount][256];
+	// The values moved to the bits of their channel in Color::value, so a pixel is the OR of four lookups.
+	uint32_t m_shifted[channelCount][256];
+};
+
+inline uint8_t LookupTable::map(Channel channel, uint8_t value) const
+{
+	return m_values[channel][value];
+}
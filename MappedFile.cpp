@@ -0,0 +1,89 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const char* filename, Access access)
+	:m_data(nullptr)
+	, m_size(0)
+	, m_file(INVALID_HANDLE_VALUE)
+	, m_mapping(nullptr)
+{
+	m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Couldn't open file.");
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(m_file);
+		throw std::runtime_error("Couldn't map file.");
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+
+	m_mapping = CreateFileMappingA(m_file, nullptr, access == Access::ReadOnly ? PAGE_READONLY : PAGE_WRITECOPY, 0, 0, nullptr);
+	if (m_mapping != nullptr)
+		m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, access == Access::ReadOnly ? FILE_MAP_READ : FILE_MAP_COPY, 0, 0, 0));
+
+	if (m_data == nullptr)
+	{
+		if (m_mapping != nullptr)
+			CloseHandle(m_mapping);
+		CloseHandle(m_file);
+		throw std::runtime_error("Couldn't map file.");
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	UnmapViewOfFile(m_data);
+	CloseHandle(m_mapping);
+	CloseHandle(m_file);
+}
+
+#else
+
+MappedFile::MappedFile(const char* filename, Access access)
+	:m_data(nullptr)
+	, m_size(0)
+{
+	int file = open(filename, O_RDONLY);
+	if (file == -1)
+		throw std::runtime_error("Couldn't open file.");
+
+	struct stat status;
+	if (fstat(file, &status) == -1 || status.st_size == 0)
+	{
+		close(file);
+		throw std::runtime_error("Couldn't map file.");
+	}
+	m_size = static_cast<size_t>(status.st_size);
+
+	// MAP_PRIVATE mappings are copy-on-write, so the file can be opened read only in both cases.
+	const int protection = access == Access::ReadOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+	void* data = mmap(nullptr, m_size, protection, MAP_PRIVATE, file, 0);
+	// The mapping stays valid after the descriptor is closed.
+	close(file);
+
+	if (data == MAP_FAILED)
+		throw std::runtime_error("Couldn't map file.");
+	m_data = static_cast<uint8_t*>(data);
+}
+
+MappedFile::~MappedFile()
+{
+	munmap(m_data, m_size);
+}
+
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Maps a whole file into memory. The pages are loaded by the OS when they are first accessed.
+class MappedFile
+{
+public:
+	enum class Access
+	{
+		// Writing to the memory is not allowed.
+		ReadOnly,
+		// Written pages become private copies, the file itself is never modified.
+		CopyOnWrite
+	};
+
+	MappedFile(const char* filename, Access access);
+	MappedFile(const MappedFile&) = delete;
+	~MappedFile();
+
+	MappedFile& operator= (const MappedFile&) = delete;
+
+	uint8_t* data() const;
+	size_t size() const;
+
+private:
+	uint8_t* m_data;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#endif
+};
+
+inline uint8_t* MappedFile::data() const
+{
+	return m_data;
+}
+
+inline size_t MappedFile::size() const
+{
+	return m_size;
+}
@@ -1,4 +1,5 @@
 #include "Matrix.h"
+#include <cmath>
 
 Matrix::Matrix(size_t width, size_t height)
 	:m_data(std::vector<float>(width * height))
@@ -75,6 +76,40 @@ Matrix Matrix::operator- () const
 	return output;
 }
 
+bool Matrix::separate(std::vector<float>& horizontal, std::vector<float>& vertical, float tolerance) const
+{
+	// Using the element with the biggest magnitude as the pivot keeps the division well conditioned.
+	size_t pivot = 0;
+	for (size_t i = 1; i < m_data.size(); i++)
+	{
+		if (std::abs(m_data[i]) > std::abs(m_data[pivot]))
+			pivot = i;
+	}
+
+	float pivotValue = m_data[pivot];
+	if (pivotValue == 0.f)
+		return false;
+
+	size_t pivotX = pivot % m_width;
+	size_t pivotY = pivot / m_width;
+
+	horizontal.assign(m_data.begin() + pivotY * m_width, m_data.begin() + (pivotY + 1) * m_width);
+	vertical.resize(m_height);
+	for (size_t y = 0; y < m_height; y++)
+		vertical[y] = m_data[y * m_width + pivotX] / pivotValue;
+
+	float maxError = tolerance * std::abs(pivotValue);
+	for (size_t y = 0; y < m_height; y++)
+	{
+		for (size_t x = 0; x < m_width; x++)
+		{
+			if (std::abs(m_data[y * m_width + x] - horizontal[x] * vertical[y]) > maxError)
+				return false;
+		}
+	}
+	return true;
+}
+
 std::ostream& operator<< (std::ostream& os, Matrix& matrix)
 {
 	for (size_t i = 1; i <= matrix.m_data.size(); i++)
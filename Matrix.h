@@ -26,6 +26,10 @@ public:
 	float get(int32_t x, int32_t y) const;
 	float set(int32_t x, int32_t y, float value);
 
+	// Factors a rank-1 matrix into a row and a column vector such that get(x, y) == horizontal[x] * vertical[y].
+	// Returns false if the matrix isn't separable within the given relative tolerance.
+	bool separate(std::vector<float>& horizontal, std::vector<float>& vertical, float tolerance = 1e-5f) const;
+
 	friend std::ostream& operator<< (std::ostream& os, Matrix& matrix);
 
 private:
@@ -0,0 +1,193 @@
+#include "Median.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Perreault and Hebert, "Median Filtering in Constant Time".
+// Every column keeps a histogram of the lumas in the rows covered by the window, which moves down by removing
+// one row and adding one. The kernel histogram is the sum of the column histograms of the window and moves right
+// by adding one column histogram and removing another. The histograms are split into 16 coarse bins and 256 fine
+// bins. The coarse kernel histogram is kept up to date for every pixel, the fine one is only updated for the
+// coarse bin that contains the median.
+// The output pixel is found without searching the window. Rows enter a column histogram at the bottom and leave at
+// the top, so the row added last with a luma is the bottom one with that luma for as long as the count is above zero.
+// The same holds for the columns entering the kernel histogram on the right, so remembering the last addition per bin
+// gives the rightmost column with the median luma and the bottom row with it in that column.
+
+static constexpr int32_t binCount = 256;
+static constexpr int32_t coarseBinCount = 16;
+static constexpr int32_t fineBinsPerCoarse = binCount / coarseBinCount;
+
+struct ColumnHistograms
+{
+	Buffer<uint16_t> fine;
+	Buffer<uint16_t> coarse;
+	// Row of the last pixel added to each fine bin.
+	Buffer<int32_t> bottomRow;
+
+	void add(int32_t column, uint8_t luma, int32_t row)
+	{
+		fine[column * binCount + luma]++;
+		coarse[column * coarseBinCount + (luma >> 4)]++;
+		bottomRow[column * binCount + luma] = row;
+	}
+
+	void remove(int32_t column, uint8_t luma)
+	{
+		fine[column * binCount + luma]--;
+		coarse[column * coarseBinCount + (luma >> 4)]--;
+	}
+};
+
+static void medianRows(ConstBitmapView source, BitmapView destination, const uint8_t* luma, int32_t radius, int32_t firstRow, int32_t lastRow)
+{
+	const int32_t width = source.width();
+	const int32_t height = source.height();
+	const int32_t diameter = 2 * radius + 1;
+	const uint32_t medianRank = static_cast<uint32_t>(diameter) * static_cast<uint32_t>(diameter) / 2;
+
+	const BufferAllocator<uint16_t> scratch(destination.allocator());
+	ColumnHistograms columns{
+		Buffer<uint16_t>(static_cast<size_t>(width) * binCount, scratch),
+		Buffer<uint16_t>(static_cast<size_t>(width) * coarseBinCount, scratch),
+		Buffer<int32_t>(static_cast<size_t>(width) * binCount, BufferAllocator<int32_t>(scratch))
+	};
+	for (int32_t k = -radius; k <= radius; k++)
+	{
+		const int32_t y = std::clamp(firstRow + k, 0, height - 1);
+		const uint8_t* row = luma + static_cast<size_t>(y) * width;
+		for (int32_t x = 0; x < width; x++)
+			columns.add(x, row[x], y);
+	}
+
+	uint32_t kernelCoarse[coarseBinCount];
+	uint32_t kernelFine[binCount];
+	// Column of the last column histogram added to each bin of kernelFine.
+	int32_t rightmostColumn[binCount];
+	// Column at which each coarse bin of kernelFine was last brought up to date.
+	int32_t kernelFineColumn[coarseBinCount];
+
+	for (int32_t y = firstRow; y < lastRow; y++)
+	{
+		if (y != firstRow)
+		{
+			const int32_t addedRow = std::clamp(y + radius, 0, height - 1);
+			const uint8_t* removed = luma + static_cast<size_t>(std::clamp(y - radius - 1, 0, height - 1)) * width;
+			const uint8_t* added = luma + static_cast<size_t>(addedRow) * width;
+			for (int32_t x = 0; x < width; x++)
+			{
+				columns.remove(x, removed[x]);
+				columns.add(x, added[x], addedRow);
+			}
+		}
+
+		std::fill(std::begin(kernelCoarse), std::end(kernelCoarse), 0);
+		std::fill(std::begin(kernelFineColumn), std::end(kernelFineColumn), std::numeric_limits<int32_t>::min());
+		for (int32_t k = -radius; k <= radius; k++)
+		{
+			const uint16_t* coarse = &columns.coarse[std::clamp(k, 0, width - 1) * coarseBinCount];
+			for (int32_t bin = 0; bin < coarseBinCount; bin++)
+				kernelCoarse[bin] += coarse[bin];
+		}
+
+		for (int32_t x = 0; x < width; x++)
+		{
+			if (x != 0)
+			{
+				const uint16_t* removed = &columns.coarse[std::clamp(x - radius - 1, 0, width - 1) * coarseBinCount];
+				const uint16_t* added = &columns.coarse[std::clamp(x + radius, 0, width - 1) * coarseBinCount];
+				for (int32_t bin = 0; bin < coarseBinCount; bin++)
+					kernelCoarse[bin] += static_cast<uint32_t>(added[bin]) - removed[bin];
+			}
+
+			uint32_t rank = medianRank;
+			int32_t coarseBin = 0;
+			while (kernelCoarse[coarseBin] <= rank)
+			{
+				rank -= kernelCoarse[coarseBin];
+				coarseBin++;
+			}
+
+			uint32_t* fine = kernelFine + coarseBin * fineBinsPerCoarse;
+			int32_t* rightmost = rightmostColumn + coarseBin * fineBinsPerCoarse;
+			const int32_t fineOffset = coarseBin * fineBinsPerCoarse;
+			const int32_t lastUpdate = kernelFineColumn[coarseBin];
+			// Sliding costs two column updates per step, so rebuilding is cheaper once the bin is far enough behind.
+			if (lastUpdate == std::numeric_limits<int32_t>::min() || 2 * (x - lastUpdate) > diameter)
+			{
+				std::fill(fine, fine + fineBinsPerCoarse, 0);
+				for (int32_t k = -radius; k <= radius; k++)
+				{
+					const int32_t columnX = std::clamp(x + k, 0, width - 1);
+					const uint16_t* column = &columns.fine[columnX * binCount + fineOffset];
+					for (int32_t bin = 0; bin < fineBinsPerCoarse; bin++)
+					{
+						fine[bin] += column[bin];
+						if (column[bin] != 0)
+							rightmost[bin] = columnX;
+					}
+				}
+			}
+			else
+			{
+				for (int32_t column = lastUpdate + 1; column <= x; column++)
+				{
+					const int32_t addedX = std::clamp(column + radius, 0, width - 1);
+					const uint16_t* removed = &columns.fine[std::clamp(column - radius - 1, 0, width - 1) * binCount + fineOffset];
+					const uint16_t* added = &columns.fine[addedX * binCount + fineOffset];
+					for (int32_t bin = 0; bin < fineBinsPerCoarse; bin++)
+					{
+						fine[bin] += static_cast<uint32_t>(added[bin]) - removed[bin];
+						if (added[bin] != 0)
+							rightmost[bin] = addedX;
+					}
+				}
+			}
+			kernelFineColumn[coarseBin] = x;
+
+			int32_t fineBin = 0;
+			while (fine[fineBin] <= rank)
+			{
+				rank -= fine[fineBin];
+				fineBin++;
+			}
+			const uint8_t median = static_cast<uint8_t>(fineOffset + fineBin);
+
+			const int32_t medianX = rightmost[fineBin];
+			const int32_t medianY = columns.bottomRow[medianX * binCount + median];
+			destination.setPixel(x, y, source.getPixel(medianX, medianY));
+		}
+	}
+}
+
+void medianFilter(ConstBitmapView source, BitmapView destination, int32_t radius, ThreadPool* pool)
+{
+	const int32_t width = source.width();
+	const int32_t height = source.height();
+	if (radius < 0 || 2 * static_cast<int64_t>(radius) + 1 > std::numeric_limits<uint16_t>::max())
+		throw std::runtime_error("Median filter radius out of range.");
+	if (destination.width() != width || destination.height() != height)
+		throw std::runtime_error("Bitmap sizes don't match.");
+	if (width == 0 || height == 0)
+		return;
+
+	Buffer<uint8_t> luma(static_cast<size_t>(width) * static_cast<size_t>(height), BufferAllocator<uint8_t>(destination.allocator()));
+	parallelFor(pool, 0, height, 0, [&](int32_t firstRow, int32_t lastRow) {
+		for (int32_t y = firstRow; y < lastRow; y++)
+		{
+			for (int32_t x = 0; x < width; x++)
+				luma[static_cast<size_t>(y) * width + x] = source.getPixel(x, y).grayscale().r;
+		}
+	});
+
+	// Every band has to fill its column histograms with the rows above it first, so the bands are kept at least as
+	// tall as the window.
+	int32_t bandHeight = height;
+	if (pool != nullptr)
+		bandHeight = std::max(2 * radius + 1, height / static_cast<int32_t>(2 * pool->threadCount()));
+
+	parallelFor(pool, 0, height, bandHeight, [&](int32_t firstRow, int32_t lastRow) {
+		medianRows(source, destination, luma.data(), radius, firstRow, lastRow);
+	});
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+
+#include "Bitmap.h"
+#include "ThreadPool.h"
+
+// Replaces every pixel with the pixel whose luma (Color::grayscale) is the median of the (2 * radius + 1)^2 window
+// around it. Pixels outside of the source are copies of the nearest edge pixel. If multiple pixels in the window
+// have the median luma, the bottom one in the rightmost column that contains the median is used.
+// The median and the pixel that has it are found with sliding column histograms, so the cost per pixel doesn't grow
+// with the radius.
+// The destination has to be the same size as the source and mustn't overlap with it, because the source pixels are
+// read while the destination is written.
+void medianFilter(ConstBitmapView source, BitmapView destination, int32_t radius, ThreadPool* pool = nullptr);
@@ -0,0 +1,122 @@
+#include "Mesh.h"
+#include "Rasterizer.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+static bool isValidW(float w)
+{
+	return w > 0 && w <= std::numeric_limits<float>::max();
+}
+
+// Triangle that covers at least one pixel, with its gradient set up once for all tiles it touches.
+struct BinnedTriangle
+{
+	uint32_t index;
+	ColorGradient gradient;
+};
+
+void drawMesh(BitmapView destination, const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, ThreadPool* pool)
+{
+	if (indexCount % 3 != 0)
+		throw std::runtime_error("Index count isn't a multiple of 3.");
+
+	const int32_t width = destination.width();
+	const int32_t height = destination.height();
+	const int32_t tilesX = (width + meshTileSize - 1) / meshTileSize;
+	const int32_t tilesY = (height + meshTileSize - 1) / meshTileSize;
+	const int32_t tileCount = tilesX * tilesY;
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || tileCount == 0)
+		return;
+
+	// The triangles are binned in batches that fill bins of their own, so the bins of one tile concatenated in batch
+	// order are still in submission order. The bins of a batch are stored back to back, with bin t in
+	// [offsets[t], offsets[t + 1]) of its bin list. The bins hold positions in the triangles of the batch.
+	const int32_t threadCount = pool != nullptr ? static_cast<int32_t>(pool->threadCount()) : 1;
+	const int32_t batchCount = static_cast<int32_t>(std::min<size_t>(triangleCount, static_cast<size_t>(threadCount) * 4));
+	std::vector<std::vector<uint32_t>> offsets(batchCount, std::vector<uint32_t>(tileCount + 1));
+	std::vector<std::vector<uint32_t>> bins(batchCount);
+	std::vector<std::vector<BinnedTriangle>> triangles(batchCount);
+
+	parallelFor(pool, 0, batchCount, 1, [&](int32_t begin, int32_t end)
+	{
+		for (int32_t batch = begin; batch < end; batch++)
+		{
+			const size_t first = triangleCount * batch / batchCount;
+			const size_t last = triangleCount * (batch + 1) / batchCount;
+			std::vector<uint32_t>& batchOffsets = offsets[batch];
+			std::vector<BinnedTriangle>& batchTriangles = triangles[batch];
+			// Pairs of triangle position and tile, counted per tile and then sorted into the bins in the same order.
+			std::vector<std::pair<uint32_t, uint32_t>> entries;
+			for (size_t i = first; i < last; i++)
+			{
+				const uint32_t* triangle = indices + i * 3;
+				if (triangle[0] >= vertexCount || triangle[1] >= vertexCount || triangle[2] >= vertexCount)
+					throw std::runtime_error("Index out of range.");
+
+				const Vertex& v1 = vertices[triangle[0]];
+				const Vertex& v2 = vertices[triangle[1]];
+				const Vertex& v3 = vertices[triangle[2]];
+				if (!isValidW(v1.w) || !isValidW(v2.w) || !isValidW(v3.w))
+					throw std::runtime_error("Invalid w.");
+
+				const TriangleRasterizer rasterizer(v1.x, v1.y, v2.x, v2.y, v3.x, v3.y, 0, 0, width, height);
+				if (rasterizer.empty())
+					continue;
+
+				const uint32_t position = static_cast<uint32_t>(batchTriangles.size());
+				batchTriangles.push_back(BinnedTriangle{ static_cast<uint32_t>(i),
+					ColorGradient(v1.x, v1.y, v2.x, v2.y, v3.x, v3.y, v1.color, v2.color, v3.color, v1.w, v2.w, v3.w) });
+				for (int32_t tileY = rasterizer.top() / meshTileSize; tileY <= (rasterizer.bottom() - 1) / meshTileSize; tileY++)
+				{
+					for (int32_t tileX = rasterizer.left() / meshTileSize; tileX <= (rasterizer.right() - 1) / meshTileSize; tileX++)
+					{
+						const uint32_t tile = static_cast<uint32_t>(tileY * tilesX + tileX);
+						entries.emplace_back(position, tile);
+						batchOffsets[tile + 1]++;
+					}
+				}
+			}
+
+			for (int32_t tile = 0; tile < tileCount; tile++)
+				batchOffsets[tile + 1] += batchOffsets[tile];
+			std::vector<uint32_t> positions(batchOffsets.begin(), batchOffsets.end() - 1);
+			std::vector<uint32_t>& batchBins = bins[batch];
+			batchBins.resize(entries.size());
+			for (const std::pair<uint32_t, uint32_t>& entry : entries)
+				batchBins[positions[entry.second]++] = entry.first;
+		}
+	});
+
+	parallelFor(pool, 0, tileCount, 1, [&](int32_t begin, int32_t end)
+	{
+		for (int32_t tile = begin; tile < end; tile++)
+		{
+			const int32_t tileLeft = tile % tilesX * meshTileSize;
+			const int32_t tileTop = tile / tilesX * meshTileSize;
+			const int32_t tileRight = std::min(tileLeft + meshTileSize, width);
+			const int32_t tileBottom = std::min(tileTop + meshTileSize, height);
+			for (int32_t batch = 0; batch < batchCount; batch++)
+			{
+				for (uint32_t j = offsets[batch][tile]; j < offsets[batch][tile + 1]; j++)
+				{
+					const BinnedTriangle& triangle = triangles[batch][bins[batch][j]];
+					const uint32_t i = triangle.index;
+					const Vertex& v1 = vertices[indices[i * 3]];
+					const Vertex& v2 = vertices[indices[i * 3 + 1]];
+					const Vertex& v3 = vertices[indices[i * 3 + 2]];
+					TriangleRasterizer rasterizer(v1.x, v1.y, v2.x, v2.y, v3.x, v3.y, tileLeft, tileTop, tileRight, tileBottom);
+					if (rasterizer.empty())
+						continue;
+
+					int32_t y, spanBegin, spanEnd;
+					while (rasterizer.nextSpan(y, spanBegin, spanEnd))
+						triangle.gradient.shadeSpan(destination.row(y) + spanBegin, spanBegin, y, spanEnd - spanBegin);
+				}
+			}
+		}
+	});
+}
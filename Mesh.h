@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "Bitmap.h"
+#include "Color.h"
+#include "ThreadPool.h"
+
+struct Vertex
+{
+	float x;
+	float y;
+	Color color;
+	// Depth for perspective correct interpolation of the color, see ColorGradient. Has to be positive.
+	float w = 1;
+};
+
+// 64 x 64 pixels are 16 KiB, which fits a tile in the L1 cache of most cores.
+constexpr int32_t meshTileSize = 64;
+
+// Fills the triangles formed by every three consecutive indices, interpolating the vertex colors across each of them.
+// Coverage is the same as Bitmap::fillTriangle, so triangles sharing an edge don't overlap.
+// The triangles are sorted into bins of meshTileSize x meshTileSize pixels and each tile is rasterized on its own, in
+// submission order, so later triangles are drawn over earlier ones exactly like a sequence of single calls. With a
+// pool the tiles are drawn in parallel and the result doesn't depend on the number of threads.
+// Throws if the index count isn't a multiple of three, an index is out of range or a w isn't positive, before anything
+// is drawn.
+void drawMesh(BitmapView destination, const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, ThreadPool* pool = nullptr);
@@ -0,0 +1,538 @@
+#include "PixelConversion.h"
+#include "intrinsics.h"
+#include <cmath>
+#include <cstring>
+
+struct BitOffsets
+{
+	uint32_t red;
+	uint32_t green;
+	uint32_t blue;
+	uint32_t alpha;
+};
+
+static uint32_t bitOffset(uint32_t mask)
+{
+	return mask == 0 ? 0 : __builtin_ctz(mask);
+}
+
+static void bgrToColorsScalar(const uint8_t* source, Color* destination, int32_t begin, int32_t end)
+{
+	for (int32_t x = begin; x < end; x++)
+	{
+		const uint8_t* pixel = source + 3 * x;
+		destination[x] = Color(pixel[2], pixel[1], pixel[0]);
+	}
+}
+
+static void colorsToBgrScalar(const Color* source, uint8_t* destination, int32_t begin, int32_t end)
+{
+	for (int32_t x = begin; x < end; x++)
+	{
+		uint8_t* pixel = destination + 3 * x;
+		pixel[0] = source[x].b;
+		pixel[1] = source[x].g;
+		pixel[2] = source[x].r;
+	}
+}
+
+static void maskedToColorsScalar(const uint8_t* source, Color* destination, int32_t begin, int32_t end, const ChannelBitmasks& masks, const BitOffsets& offsets)
+{
+	for (int32_t x = begin; x < end; x++)
+	{
+		uint32_t value;
+		memcpy(&value, source + 4 * x, sizeof(value));
+		destination[x] = Color(
+			static_cast<uint8_t>((value & masks.red) >> offsets.red),
+			static_cast<uint8_t>((value & masks.green) >> offsets.green),
+			static_cast<uint8_t>((value & masks.blue) >> offsets.blue),
+			static_cast<uint8_t>((value & masks.alpha) >> offsets.alpha)
+		);
+	}
+}
+
+static void rgbToColorsScalar(const uint8_t* source, Color* destination, int32_t begin, int32_t end)
+{
+	for (int32_t x = begin; x < end; x++)
+	{
+		const uint8_t* pixel = source + 3 * x;
+		destination[x] = Color(pixel[0], pixel[1], pixel[2]);
+	}
+}
+
+static void colorsToRgbScalar(const Color* source, uint8_t* destination, int32_t begin, int32_t end)
+{
+	for (int32_t x = begin; x < end; x++)
+	{
+		uint8_t* pixel = destination + 3 * x;
+		pixel[0] = source[x].r;
+		pixel[1] = source[x].g;
+		pixel[2] = source[x].b;
+	}
+}
+
+static void rgbaToColorsScalar(const uint8_t* source, Color* destination, int32_t begin, int32_t end)
+{
+	for (int32_t x = begin; x < end; x++)
+	{
+		const uint8_t* pixel = source + 4 * x;
+		destination[x] = Color(pixel[0], pixel[1], pixel[2], pixel[3]);
+	}
+}
+
+static void colorsToRgbaScalar(const Color* source, uint8_t* destination, int32_t begin, int32_t end)
+{
+	for (int32_t x = begin; x < end; x++)
+	{
+		uint8_t* pixel = destination + 4 * x;
+		pixel[0] = source[x].r;
+		pixel[1] = source[x].g;
+		pixel[2] = source[x].b;
+		pixel[3] = source[x].a;
+	}
+}
+
+static void colorsToPlanesScalar(const Color* source, float* const destination[4], int32_t begin, int32_t end)
+{
+	for (int32_t x = begin; x < end; x++)
+	{
+		destination[0][x] = source[x].r;
+		destination[1][x] = source[x].g;
+		destination[2][x] = source[x].b;
+		destination[3][x] = source[x].a;
+	}
+}
+
+// Written so NaN fails both comparisons and becomes 0 like with the max and min instructions of the SIMD paths. The
+// rounding of nearbyint is the same as the one of the conversion instructions, to nearest even.
+static uint8_t planeToChannel(float value)
+{
+	return static_cast<uint8_t>(std::nearbyint(value > 0.f ? (value < 255.f ? value : 255.f) : 0.f));
+}
+
+static void planesToColorsScalar(const float* const source[4], Color* destination, int32_t begin, int32_t end)
+{
+	for (int32_t x = begin; x < end; x++)
+		destination[x] = Color(planeToChannel(source[0][x]), planeToChannel(source[1][x]), planeToChannel(source[2][x]), planeToChannel(source[3][x]));
+}
+
+#ifdef BITMAP_X86
+
+// Moves the 3 bytes of each pixel to the top of a 32 bit lane and zeroes the lowest byte, which is then set to 255.
+// In memory a Color is alpha, blue, green, red, so the byte order of the pixel stays the same.
+#define BGR_TO_COLOR_SHUFFLE -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11
+
+TARGET_SSE41 static void bgrToColorsSse41(const uint8_t* source, Color* destination, int32_t begin, int32_t end)
+{
+	const __m128i shuffle = _mm_setr_epi8(BGR_TO_COLOR_SHUFFLE);
+	const __m128i alpha = _mm_set1_epi32(0xFF);
+	int32_t x = begin;
+	// Each step reads 16 bytes but only uses 12.
+	for (; x + 6 <= end; x += 4)
+	{
+		const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 3 * x));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+	}
+	bgrToColorsScalar(source, destination, x, end);
+}
+
+TARGET_AVX2 static void bgrToColorsAvx2(const uint8_t* source, Color* destination, int32_t begin, int32_t end)
+{
+	const __m256i shuffle = _mm256_setr_epi8(BGR_TO_COLOR_SHUFFLE, BGR_TO_COLOR_SHUFFLE);
+	const __m256i alpha = _mm256_set1_epi32(0xFF);
+	int32_t x = begin;
+	// The shuffle works within 128 bit lanes, so the upper lane is loaded starting at the fifth pixel.
+	for (; x + 10 <= end; x += 8)
+	{
+		const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 3 * x));
+		const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 3 * x + 12));
+		const __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + x), _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha));
+	}
+	bgrToColorsSse41(source, destination, x, end);
+}
+
+#undef BGR_TO_COLOR_SHUFFLE
+
+// Drops the alpha byte of each pixel and packs the remaining 12 bytes at the start of the 128 bit lane.
+#define COLOR_TO_BGR_SHUFFLE 1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1
+
+TARGET_SSE41 static void colorsToBgrSse41(const Color* source, uint8_t* destination, int32_t begin, int32_t end)
+{
+	const __m128i shuffle = _mm_setr_epi8(COLOR_TO_BGR_SHUFFLE);
+	int32_t x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		const __m128i pixels = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x)), shuffle);
+		// Only 12 of the 16 bytes are valid, so they are stored in two parts to not write past the end of the row.
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(destination + 3 * x), pixels);
+		const int32_t last = _mm_extract_epi32(pixels, 2);
+		memcpy(destination + 3 * x + 8, &last, sizeof(last));
+	}
+	colorsToBgrScalar(source, destination, x, end);
+}
+
+TARGET_AVX2 static void colorsToBgrAvx2(const Color* source, uint8_t* destination, int32_t begin, int32_t end)
+{
+	const __m256i shuffle = _mm256_setr_epi8(COLOR_TO_BGR_SHUFFLE, COLOR_TO_BGR_SHUFFLE);
+	// Moves the 12 valid bytes of the upper lane directly behind the ones of the lower lane.
+	const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		__m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + x));
+		pixels = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(pixels, shuffle), compact);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 3 * x), _mm256_castsi256_si128(pixels));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(destination + 3 * x + 16), _mm256_extracti128_si256(pixels, 1));
+	}
+	colorsToBgrSse41(source, destination, x, end);
+}
+
+#undef COLOR_TO_BGR_SHUFFLE
+
+// Same as above but reverses the order of the color bytes.
+#define RGB_TO_COLOR_SHUFFLE -1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9
+// Drops the alpha and stores the remaining bytes in reverse order in the first 12 bytes.
+#define COLOR_TO_RGB_SHUFFLE 3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, -1, -1, -1, -1
+// RGBA is the reverse of the byte order of a Color in memory, so converting either way is the same shuffle.
+#define REVERSE_BYTES_SHUFFLE 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+
+TARGET_SSE41 static void rgbToColorsSse41(const uint8_t* source, Color* destination, int32_t begin, int32_t end)
+{
+	const __m128i shuffle = _mm_setr_epi8(RGB_TO_COLOR_SHUFFLE);
+	const __m128i alpha = _mm_set1_epi32(0xFF);
+	int32_t x = begin;
+	for (; x + 6 <= end; x += 4)
+	{
+		const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 3 * x));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+	}
+	rgbToColorsScalar(source, destination, x, end);
+}
+
+TARGET_AVX2 static void rgbToColorsAvx2(const uint8_t* source, Color* destination, int32_t begin, int32_t end)
+{
+	const __m256i shuffle = _mm256_setr_epi8(RGB_TO_COLOR_SHUFFLE, RGB_TO_COLOR_SHUFFLE);
+	const __m256i alpha = _mm256_set1_epi32(0xFF);
+	int32_t x = begin;
+	for (; x + 10 <= end; x += 8)
+	{
+		const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 3 * x));
+		const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 3 * x + 12));
+		const __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + x), _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha));
+	}
+	rgbToColorsSse41(source, destination, x, end);
+}
+
+TARGET_SSE41 static void colorsToRgbSse41(const Color* source, uint8_t* destination, int32_t begin, int32_t end)
+{
+	const __m128i shuffle = _mm_setr_epi8(COLOR_TO_RGB_SHUFFLE);
+	int32_t x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		const __m128i pixels = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x)), shuffle);
+		// Only 12 of the 16 bytes are valid, so they are stored in two parts to not write past the end of the row.
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(destination + 3 * x), pixels);
+		const int32_t last = _mm_extract_epi32(pixels, 2);
+		memcpy(destination + 3 * x + 8, &last, sizeof(last));
+	}
+	colorsToRgbScalar(source, destination, x, end);
+}
+
+TARGET_SSE41 static void swapRgbaSse41(const uint8_t* source, uint8_t* destination, int32_t begin, int32_t end)
+{
+	const __m128i shuffle = _mm_setr_epi8(REVERSE_BYTES_SHUFFLE);
+	int32_t x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 4 * x));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 4 * x), _mm_shuffle_epi8(pixels, shuffle));
+	}
+	for (; x < end; x++)
+	{
+		for (int32_t i = 0; i < 4; i++)
+			destination[4 * x + i] = source[4 * x + 3 - i];
+	}
+}
+
+TARGET_AVX2 static void swapRgbaAvx2(const uint8_t* source, uint8_t* destination, int32_t begin, int32_t end)
+{
+	const __m256i shuffle = _mm256_setr_epi8(REVERSE_BYTES_SHUFFLE, REVERSE_BYTES_SHUFFLE);
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 4 * x));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + 4 * x), _mm256_shuffle_epi8(pixels, shuffle));
+	}
+	swapRgbaSse41(source, destination, x, end);
+}
+
+#undef RGB_TO_COLOR_SHUFFLE
+#undef COLOR_TO_RGB_SHUFFLE
+#undef REVERSE_BYTES_SHUFFLE
+
+TARGET_SSE41 static void maskedToColorsSse41(const uint8_t* source, Color* destination, int32_t begin, int32_t end, const ChannelBitmasks& masks, const BitOffsets& offsets)
+{
+	const __m128i redMask = _mm_set1_epi32(masks.red);
+	const __m128i greenMask = _mm_set1_epi32(masks.green);
+	const __m128i blueMask = _mm_set1_epi32(masks.blue);
+	const __m128i alphaMask = _mm_set1_epi32(masks.alpha);
+	const __m128i redOffset = _mm_cvtsi32_si128(offsets.red);
+	const __m128i greenOffset = _mm_cvtsi32_si128(offsets.green);
+	const __m128i blueOffset = _mm_cvtsi32_si128(offsets.blue);
+	const __m128i alphaOffset = _mm_cvtsi32_si128(offsets.alpha);
+	const __m128i byteMask = _mm_set1_epi32(0xFF);
+	int32_t x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 4 * x));
+		const __m128i red = _mm_and_si128(_mm_srl_epi32(_mm_and_si128(values, redMask), redOffset), byteMask);
+		const __m128i green = _mm_and_si128(_mm_srl_epi32(_mm_and_si128(values, greenMask), greenOffset), byteMask);
+		const __m128i blue = _mm_and_si128(_mm_srl_epi32(_mm_and_si128(values, blueMask), blueOffset), byteMask);
+		const __m128i alpha = _mm_and_si128(_mm_srl_epi32(_mm_and_si128(values, alphaMask), alphaOffset), byteMask);
+		const __m128i pixels = _mm_or_si128(
+			_mm_or_si128(_mm_slli_epi32(red, 24), _mm_slli_epi32(green, 16)),
+			_mm_or_si128(_mm_slli_epi32(blue, 8), alpha)
+		);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x), pixels);
+	}
+	maskedToColorsScalar(source, destination, x, end, masks, offsets);
+}
+
+TARGET_AVX2 static void maskedToColorsAvx2(const uint8_t* source, Color* destination, int32_t begin, int32_t end, const ChannelBitmasks& masks, const BitOffsets& offsets)
+{
+	const __m256i redMask = _mm256_set1_epi32(masks.red);
+	const __m256i greenMask = _mm256_set1_epi32(masks.green);
+	const __m256i blueMask = _mm256_set1_epi32(masks.blue);
+	const __m256i alphaMask = _mm256_set1_epi32(masks.alpha);
+	const __m128i redOffset = _mm_cvtsi32_si128(offsets.red);
+	const __m128i greenOffset = _mm_cvtsi32_si128(offsets.green);
+	const __m128i blueOffset = _mm_cvtsi32_si128(offsets.blue);
+	const __m128i alphaOffset = _mm_cvtsi32_si128(offsets.alpha);
+	const __m256i byteMask = _mm256_set1_epi32(0xFF);
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 4 * x));
+		const __m256i red = _mm256_and_si256(_mm256_srl_epi32(_mm256_and_si256(values, redMask), redOffset), byteMask);
+		const __m256i green = _mm256_and_si256(_mm256_srl_epi32(_mm256_and_si256(values, greenMask), greenOffset), byteMask);
+		const __m256i blue = _mm256_and_si256(_mm256_srl_epi32(_mm256_and_si256(values, blueMask), blueOffset), byteMask);
+		const __m256i alpha = _mm256_and_si256(_mm256_srl_epi32(_mm256_and_si256(values, alphaMask), alphaOffset), byteMask);
+		const __m256i pixels = _mm256_or_si256(
+			_mm256_or_si256(_mm256_slli_epi32(red, 24), _mm256_slli_epi32(green, 16)),
+			_mm256_or_si256(_mm256_slli_epi32(blue, 8), alpha)
+		);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + x), pixels);
+	}
+	maskedToColorsSse41(source, destination, x, end, masks, offsets);
+}
+
+TARGET_SSE41 static void colorsToPlanesSse41(const Color* source, float* const destination[4], int32_t begin, int32_t end)
+{
+	const __m128i byteMask = _mm_set1_epi32(0xFF);
+	int32_t x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x));
+		_mm_storeu_ps(destination[0] + x, _mm_cvtepi32_ps(_mm_srli_epi32(pixels, 24)));
+		_mm_storeu_ps(destination[1] + x, _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), byteMask)));
+		_mm_storeu_ps(destination[2] + x, _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), byteMask)));
+		_mm_storeu_ps(destination[3] + x, _mm_cvtepi32_ps(_mm_and_si128(pixels, byteMask)));
+	}
+	colorsToPlanesScalar(source, destination, x, end);
+}
+
+TARGET_AVX2 static void colorsToPlanesAvx2(const Color* source, float* const destination[4], int32_t begin, int32_t end)
+{
+	const __m256i byteMask = _mm256_set1_epi32(0xFF);
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + x));
+		_mm256_storeu_ps(destination[0] + x, _mm256_cvtepi32_ps(_mm256_srli_epi32(pixels, 24)));
+		_mm256_storeu_ps(destination[1] + x, _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), byteMask)));
+		_mm256_storeu_ps(destination[2] + x, _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask)));
+		_mm256_storeu_ps(destination[3] + x, _mm256_cvtepi32_ps(_mm256_and_si256(pixels, byteMask)));
+	}
+	colorsToPlanesSse41(source, destination, x, end);
+}
+
+// The channels are clamped with max(value, 0) first, which returns 0 for NaN, and converted with the default rounding.
+TARGET_SSE41 static void planesToColorsSse41(const float* const source[4], Color* destination, int32_t begin, int32_t end)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 max = _mm_set1_ps(255.f);
+	int32_t x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		__m128i channels[4];
+		for (int c = 0; c < 4; c++)
+			channels[c] = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(source[c] + x), zero), max));
+		const __m128i pixels = _mm_or_si128(
+			_mm_or_si128(_mm_slli_epi32(channels[0], 24), _mm_slli_epi32(channels[1], 16)),
+			_mm_or_si128(_mm_slli_epi32(channels[2], 8), channels[3])
+		);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x), pixels);
+	}
+	planesToColorsScalar(source, destination, x, end);
+}
+
+TARGET_AVX2 static void planesToColorsAvx2(const float* const source[4], Color* destination, int32_t begin, int32_t end)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 max = _mm256_set1_ps(255.f);
+	int32_t x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		__m256i channels[4];
+		for (int c = 0; c < 4; c++)
+			channels[c] = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(source[c] + x), zero), max));
+		const __m256i pixels = _mm256_or_si256(
+			_mm256_or_si256(_mm256_slli_epi32(channels[0], 24), _mm256_slli_epi32(channels[1], 16)),
+			_mm256_or_si256(_mm256_slli_epi32(channels[2], 8), channels[3])
+		);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + x), pixels);
+	}
+	planesToColorsSse41(source, destination, x, end);
+}
+
+#endif
+
+void bgrToColors(const uint8_t* source, Color* destination, int32_t count)
+{
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		return bgrToColorsAvx2(source, destination, 0, count);
+	case SimdLevel::Sse41:
+		return bgrToColorsSse41(source, destination, 0, count);
+	default:
+		break;
+	}
+#endif
+	bgrToColorsScalar(source, destination, 0, count);
+}
+
+void colorsToBgr(const Color* source, uint8_t* destination, int32_t count)
+{
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		return colorsToBgrAvx2(source, destination, 0, count);
+	case SimdLevel::Sse41:
+		return colorsToBgrSse41(source, destination, 0, count);
+	default:
+		break;
+	}
+#endif
+	colorsToBgrScalar(source, destination, 0, count);
+}
+
+void maskedToColors(const uint8_t* source, Color* destination, int32_t count, const ChannelBitmasks& masks)
+{
+	const BitOffsets offsets{ bitOffset(masks.red), bitOffset(masks.green), bitOffset(masks.blue), bitOffset(masks.alpha) };
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		return maskedToColorsAvx2(source, destination, 0, count, masks, offsets);
+	case SimdLevel::Sse41:
+		return maskedToColorsSse41(source, destination, 0, count, masks, offsets);
+	default:
+		break;
+	}
+#endif
+	maskedToColorsScalar(source, destination, 0, count, masks, offsets);
+}
+
+void rgbToColors(const uint8_t* source, Color* destination, int32_t count)
+{
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		return rgbToColorsAvx2(source, destination, 0, count);
+	case SimdLevel::Sse41:
+		return rgbToColorsSse41(source, destination, 0, count);
+	default:
+		break;
+	}
+#endif
+	rgbToColorsScalar(source, destination, 0, count);
+}
+
+void colorsToRgb(const Color* source, uint8_t* destination, int32_t count)
+{
+#ifdef BITMAP_X86
+	if (simdLevel() >= SimdLevel::Sse41)
+		return colorsToRgbSse41(source, destination, 0, count);
+#endif
+	colorsToRgbScalar(source, destination, 0, count);
+}
+
+void rgbaToColors(const uint8_t* source, Color* destination, int32_t count)
+{
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		return swapRgbaAvx2(source, reinterpret_cast<uint8_t*>(destination), 0, count);
+	case SimdLevel::Sse41:
+		return swapRgbaSse41(source, reinterpret_cast<uint8_t*>(destination), 0, count);
+	default:
+		break;
+	}
+#endif
+	rgbaToColorsScalar(source, destination, 0, count);
+}
+
+void colorsToRgba(const Color* source, uint8_t* destination, int32_t count)
+{
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		return swapRgbaAvx2(reinterpret_cast<const uint8_t*>(source), destination, 0, count);
+	case SimdLevel::Sse41:
+		return swapRgbaSse41(reinterpret_cast<const uint8_t*>(source), destination, 0, count);
+	default:
+		break;
+	}
+#endif
+	colorsToRgbaScalar(source, destination, 0, count);
+}
+
+void colorsToPlanes(const Color* source, float* const destination[4], int32_t count)
+{
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		return colorsToPlanesAvx2(source, destination, 0, count);
+	case SimdLevel::Sse41:
+		return colorsToPlanesSse41(source, destination, 0, count);
+	default:
+		break;
+	}
+#endif
+	colorsToPlanesScalar(source, destination, 0, count);
+}
+
+void planesToColors(const float* const source[4], Color* destination, int32_t count)
+{
+#ifdef BITMAP_X86
+	switch (simdLevel())
+	{
+	case SimdLevel::Avx2:
+		return planesToColorsAvx2(source, destination, 0, count);
+	case SimdLevel::Sse41:
+		return planesToColorsSse41(source, destination, 0, count);
+	default:
+		break;
+	}
+#endif
+	planesToColorsScalar(source, destination, 0, count);
+}
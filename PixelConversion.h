@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+
+#include "Color.h"
+
+// Conversions between rows of Color and the pixel layouts used by image files. The source bytes don't have to be aligned.
+
+struct ChannelBitmasks
+{
+	uint32_t red;
+	uint32_t green;
+	uint32_t blue;
+	uint32_t alpha;
+};
+
+// 24 bit BMP pixels - blue, green, red. The alpha is set to 255.
+void bgrToColors(const uint8_t* source, Color* destination, int32_t count);
+void colorsToBgr(const Color* source, uint8_t* destination, int32_t count);
+
+// 32 bit little endian pixels with each channel extracted using its mask. Zero masks produce zero channels.
+void maskedToColors(const uint8_t* source, Color* destination, int32_t count, const ChannelBitmasks& masks);
+
+// Netpbm pixels - red, green, blue. The alpha is set to 255 when reading and dropped when writing.
+void rgbToColors(const uint8_t* source, Color* destination, int32_t count);
+void colorsToRgb(const Color* source, uint8_t* destination, int32_t count);
+
+// PAM RGB_ALPHA pixels - red, green, blue, alpha.
+void rgbaToColors(const uint8_t* source, Color* destination, int32_t count);
+void colorsToRgba(const Color* source, uint8_t* destination, int32_t count);
+
+// Separate float planes - red, green, blue, alpha - with values from 0 to 255, as stored by FloatImage. Colors are
+// made by clamping to [0, 255] and rounding to the nearest integer. NaN becomes 0.
+void colorsToPlanes(const Color* source, float* const destination[4], int32_t count);
+void planesToColors(const float* const source[4], Color* destination, int32_t count);
@@ -0,0 +1,436 @@
+#include "Rasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "intrinsics.h"
+
+static int64_t floorDivide(int64_t value, int64_t divisor)
+{
+	return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+static int64_t ceilDivide(int64_t value, int64_t divisor)
+{
+	return -floorDivide(-value, divisor);
+}
+
+#ifdef BITMAP_X86
+
+TARGET_SSE41 static void fillSpanSse41(Color* destination, int32_t count, Color color)
+{
+	const __m128i pattern = _mm_set1_epi32(static_cast<int32_t>(color.value));
+	int32_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), pattern);
+	// The last pixels are covered by a store overlapping the previous one.
+	if (i < count && count >= 4)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + count - 4), pattern);
+	else
+		std::fill_n(destination + i, count - i, color);
+}
+
+TARGET_AVX2 static void fillSpanAvx2(Color* destination, int32_t count, Color color)
+{
+	if (count < 8)
+	{
+		fillSpanSse41(destination, count, color);
+		return;
+	}
+
+	const __m256i pattern = _mm256_set1_epi32(static_cast<int32_t>(color.value));
+	int32_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), pattern);
+	if (i < count)
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + count - 8), pattern);
+}
+
+#endif
+
+void fillSpan(Color* destination, int32_t count, Color color)
+{
+	switch (simdLevel())
+	{
+#ifdef BITMAP_X86
+	case SimdLevel::Avx2:
+		fillSpanAvx2(destination, count, color);
+		break;
+	case SimdLevel::Sse41:
+		fillSpanSse41(destination, count, color);
+		break;
+#endif
+	default:
+		std::fill_n(destination, count, color);
+	}
+}
+
+TriangleRasterizer::TriangleRasterizer(float x1, float y1, float x2, float y2, float x3, float y3, int32_t clipLeft, int32_t clipTop, int32_t clipRight, int32_t clipBottom)
+	:m_edges{}
+	, m_left(0)
+	, m_right(0)
+	, m_top(0)
+	, m_y(0)
+	, m_bottom(0)
+{
+	const float coordinates[6]{ x1, y1, x2, y2, x3, y3 };
+	for (float coordinate : coordinates)
+	{
+		// Also rejects NaN.
+		if (!(std::abs(coordinate) <= maxCoordinate))
+			return;
+	}
+
+	int64_t x[3]{ snap(x1), snap(x2), snap(x3) };
+	int64_t y[3]{ snap(y1), snap(y2), snap(y3) };
+
+	// The edge functions are positive inside of triangles with this winding, so the other one is flipped.
+	const int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (area == 0)
+		return;
+	if (area < 0)
+	{
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+	}
+
+	const int64_t pixel = int64_t(1) << subpixelBits;
+	m_left = static_cast<int32_t>(std::max<int64_t>(clipLeft, ceilDivide(*std::min_element(x, x + 3), pixel)));
+	m_right = static_cast<int32_t>(std::min<int64_t>(clipRight, floorDivide(*std::max_element(x, x + 3), pixel) + 1));
+	m_y = static_cast<int32_t>(std::max<int64_t>(clipTop, ceilDivide(*std::min_element(y, y + 3), pixel)));
+	m_bottom = static_cast<int32_t>(std::min<int64_t>(clipBottom, floorDivide(*std::max_element(y, y + 3), pixel) + 1));
+	m_top = m_y;
+	if (m_left >= m_right)
+		m_bottom = m_y;
+
+	for (int i = 0; i < 3; i++)
+	{
+		const int j = (i + 1) % 3;
+		const int64_t deltaX = x[j] - x[i];
+		const int64_t deltaY = y[j] - y[i];
+		// Points on the edge are inside if the triangle is to the right of it (left edge) or below it (top edge).
+		const bool topLeft = deltaY < 0 || (deltaY == 0 && deltaX > 0);
+
+		Edge& edge = m_edges[i];
+		edge.value = deltaX * (m_y * pixel - y[i]) - deltaY * (m_left * pixel - x[i]) - (topLeft ? 0 : 1);
+		edge.stepX = -deltaY * pixel;
+		edge.stepY = deltaX * pixel;
+	}
+}
+
+bool TriangleRasterizer::nextSpan(int32_t& y, int32_t& begin, int32_t& end)
+{
+	while (m_y < m_bottom)
+	{
+		// Offsets from m_left of the first and last covered pixel.
+		int64_t first = 0;
+		int64_t last = m_right - m_left - 1;
+		for (Edge& edge : m_edges)
+		{
+			if (edge.stepX > 0)
+			{
+				if (edge.value < 0)
+					first = std::max(first, ceilDivide(-edge.value, edge.stepX));
+			}
+			else if (edge.value < 0)
+				last = -1;
+			else if (edge.stepX < 0)
+				last = std::min(last, edge.value / -edge.stepX);
+
+			edge.value += edge.stepY;
+		}
+
+		y = m_y++;
+		if (first <= last)
+		{
+			begin = m_left + static_cast<int32_t>(first);
+			end = m_left + static_cast<int32_t>(last) + 1;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Writes count pixels starting with the fixed point channels in start, in memory order, and adding step for every
+// pixel. The arithmetic wraps like the SIMD versions.
+static void shadeAffineScalar(Color* destination, const int32_t* start, const int32_t* step, int32_t count)
+{
+	uint32_t values[4]{ static_cast<uint32_t>(start[0]), static_cast<uint32_t>(start[1]), static_cast<uint32_t>(start[2]), static_cast<uint32_t>(start[3]) };
+	for (int32_t i = 0; i < count; i++)
+	{
+		uint8_t channels[4];
+		for (int j = 0; j < 4; j++)
+		{
+			channels[j] = static_cast<uint8_t>(std::clamp(static_cast<int32_t>(values[j]), 0, 0xffffff) >> 16);
+			values[j] += static_cast<uint32_t>(step[j]);
+		}
+		destination[i] = Color(channels[3], channels[2], channels[1], channels[0]);
+	}
+}
+
+// Start and step hold the four channels in memory order followed by 1 / w.
+static void shadePerspectiveScalar(Color* destination, const float* start, const float* step, int32_t x, int32_t count)
+{
+	for (int32_t i = 0; i < count; i++)
+	{
+		const float position = static_cast<float>(x + i);
+		const float inverseW = start[4] + step[4] * position;
+		uint8_t channels[4];
+		for (int j = 0; j < 4; j++)
+			channels[j] = static_cast<uint8_t>(std::clamp((start[j] + step[j] * position) / inverseW + 0.5f, 0.f, 255.f));
+		destination[i] = Color(channels[3], channels[2], channels[1], channels[0]);
+	}
+}
+
+#ifdef BITMAP_X86
+
+// Packs four pixels of fixed point channels into 16 bytes.
+TARGET_SSE41 static inline __m128i packFixedSse41(__m128i pixel0, __m128i pixel1, __m128i pixel2, __m128i pixel3)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i maximum = _mm_set1_epi32(0xffffff);
+	pixel0 = _mm_srli_epi32(_mm_min_epi32(_mm_max_epi32(pixel0, zero), maximum), 16);
+	pixel1 = _mm_srli_epi32(_mm_min_epi32(_mm_max_epi32(pixel1, zero), maximum), 16);
+	pixel2 = _mm_srli_epi32(_mm_min_epi32(_mm_max_epi32(pixel2, zero), maximum), 16);
+	pixel3 = _mm_srli_epi32(_mm_min_epi32(_mm_max_epi32(pixel3, zero), maximum), 16);
+	return _mm_packus_epi16(_mm_packus_epi32(pixel0, pixel1), _mm_packus_epi32(pixel2, pixel3));
+}
+
+TARGET_SSE41 static void shadeAffineSse41(Color* destination, const int32_t* start, const int32_t* step, int32_t count)
+{
+	const __m128i step1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(step));
+	const __m128i step2 = _mm_add_epi32(step1, step1);
+	const __m128i step4 = _mm_add_epi32(step2, step2);
+	__m128i pixel0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(start));
+	__m128i pixel1 = _mm_add_epi32(pixel0, step1);
+	__m128i pixel2 = _mm_add_epi32(pixel0, step2);
+	__m128i pixel3 = _mm_add_epi32(pixel1, step2);
+
+	int32_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), packFixedSse41(pixel0, pixel1, pixel2, pixel3));
+		pixel0 = _mm_add_epi32(pixel0, step4);
+		pixel1 = _mm_add_epi32(pixel1, step4);
+		pixel2 = _mm_add_epi32(pixel2, step4);
+		pixel3 = _mm_add_epi32(pixel3, step4);
+	}
+
+	int32_t rest[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(rest), pixel0);
+	shadeAffineScalar(destination + i, rest, step, count - i);
+}
+
+TARGET_AVX2 static void shadeAffineAvx2(Color* destination, const int32_t* start, const int32_t* step, int32_t count)
+{
+	// Register k holds pixels k and k + 4, so packing the four registers puts the pixels in order.
+	const __m128i step1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(step));
+	const __m128i step4 = _mm_slli_epi32(step1, 2);
+	const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(start));
+	const __m256i step1x2 = _mm256_broadcastsi128_si256(step1);
+	const __m256i step8 = _mm256_slli_epi32(step1x2, 3);
+	__m256i pixel0 = _mm256_inserti128_si256(_mm256_castsi128_si256(first), _mm_add_epi32(first, step4), 1);
+	__m256i pixel1 = _mm256_add_epi32(pixel0, step1x2);
+	__m256i pixel2 = _mm256_add_epi32(pixel1, step1x2);
+	__m256i pixel3 = _mm256_add_epi32(pixel2, step1x2);
+
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i maximum = _mm256_set1_epi32(0xffffff);
+	int32_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256i clamped0 = _mm256_srli_epi32(_mm256_min_epi32(_mm256_max_epi32(pixel0, zero), maximum), 16);
+		const __m256i clamped1 = _mm256_srli_epi32(_mm256_min_epi32(_mm256_max_epi32(pixel1, zero), maximum), 16);
+		const __m256i clamped2 = _mm256_srli_epi32(_mm256_min_epi32(_mm256_max_epi32(pixel2, zero), maximum), 16);
+		const __m256i clamped3 = _mm256_srli_epi32(_mm256_min_epi32(_mm256_max_epi32(pixel3, zero), maximum), 16);
+		const __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(clamped0, clamped1), _mm256_packus_epi32(clamped2, clamped3));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), packed);
+		pixel0 = _mm256_add_epi32(pixel0, step8);
+		pixel1 = _mm256_add_epi32(pixel1, step8);
+		pixel2 = _mm256_add_epi32(pixel2, step8);
+		pixel3 = _mm256_add_epi32(pixel3, step8);
+	}
+
+	int32_t rest[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(rest), _mm256_castsi256_si128(pixel0));
+	shadeAffineSse41(destination + i, rest, step, count - i);
+}
+
+TARGET_SSE41 static inline __m128i perspectivePixelSse41(__m128 start, __m128 step, float inverseWStart, float inverseWStep, int32_t x)
+{
+	const float position = static_cast<float>(x);
+	const float inverseW = inverseWStart + inverseWStep * position;
+	const __m128 value = _mm_add_ps(_mm_div_ps(_mm_add_ps(start, _mm_mul_ps(step, _mm_set1_ps(position))), _mm_set1_ps(inverseW)), _mm_set1_ps(0.5f));
+	return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(255.f)));
+}
+
+TARGET_SSE41 static void shadePerspectiveSse41(Color* destination, const float* start, const float* step, int32_t x, int32_t count)
+{
+	const __m128 channelStart = _mm_loadu_ps(start);
+	const __m128 channelStep = _mm_loadu_ps(step);
+	int32_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i pixel0 = perspectivePixelSse41(channelStart, channelStep, start[4], step[4], x + i);
+		const __m128i pixel1 = perspectivePixelSse41(channelStart, channelStep, start[4], step[4], x + i + 1);
+		const __m128i pixel2 = perspectivePixelSse41(channelStart, channelStep, start[4], step[4], x + i + 2);
+		const __m128i pixel3 = perspectivePixelSse41(channelStart, channelStep, start[4], step[4], x + i + 3);
+		const __m128i packed = _mm_packus_epi16(_mm_packus_epi32(pixel0, pixel1), _mm_packus_epi32(pixel2, pixel3));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), packed);
+	}
+	shadePerspectiveScalar(destination + i, start, step, x + i, count - i);
+}
+
+#endif
+
+ColorGradient::ColorGradient(float x1, float y1, float x2, float y2, float x3, float y3, Color color1, Color color2, Color color3, float w1, float w2, float w3)
+	:m_mode(Mode::Constant)
+	, m_color(color1)
+	, m_planes{}
+	, m_fixedStepX{}
+	, m_originX(0)
+	, m_originY(0)
+{
+	const float ws[3]{ w1, w2, w3 };
+	for (float w : ws)
+	{
+		if (!(w > 0 && w <= std::numeric_limits<float>::max()))
+			throw std::runtime_error("Invalid w.");
+	}
+
+	if (color1 == color2 && color1 == color3)
+		return;
+	const float coordinates[6]{ x1, y1, x2, y2, x3, y3 };
+	for (float coordinate : coordinates)
+	{
+		if (!(std::abs(coordinate) <= TriangleRasterizer::maxCoordinate))
+			return;
+	}
+
+	const int64_t x[3]{ TriangleRasterizer::snap(x1), TriangleRasterizer::snap(x2), TriangleRasterizer::snap(x3) };
+	const int64_t y[3]{ TriangleRasterizer::snap(y1), TriangleRasterizer::snap(y2), TriangleRasterizer::snap(y3) };
+	const int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (area == 0)
+		return;
+
+	const double pixel = static_cast<double>(1 << TriangleRasterizer::subpixelBits);
+	m_originX = x[0] / pixel;
+	m_originY = y[0] / pixel;
+	const auto plane = [&](double value1, double value2, double value3)
+	{
+		const double delta2 = value2 - value1;
+		const double delta3 = value3 - value1;
+		const double stepX = (delta2 * static_cast<double>(y[2] - y[0]) - delta3 * static_cast<double>(y[1] - y[0])) * pixel / static_cast<double>(area);
+		const double stepY = (delta3 * static_cast<double>(x[1] - x[0]) - delta2 * static_cast<double>(x[2] - x[0])) * pixel / static_cast<double>(area);
+		return Plane{ value1, stepX, stepY };
+	};
+
+	const uint8_t channels1[4]{ color1.a, color1.b, color1.g, color1.r };
+	const uint8_t channels2[4]{ color2.a, color2.b, color2.g, color2.r };
+	const uint8_t channels3[4]{ color3.a, color3.b, color3.g, color3.r };
+	if (w1 != w2 || w1 != w3)
+	{
+		// Scaled so that the largest 1 / w is 1.
+		const float minimumW = std::min({ w1, w2, w3 });
+		const double inverseW1 = minimumW / static_cast<double>(w1);
+		const double inverseW2 = minimumW / static_cast<double>(w2);
+		const double inverseW3 = minimumW / static_cast<double>(w3);
+		for (int i = 0; i < 4; i++)
+			m_planes[i] = plane(channels1[i] * inverseW1, channels2[i] * inverseW2, channels3[i] * inverseW3);
+		m_planes[4] = plane(inverseW1, inverseW2, inverseW3);
+		m_mode = Mode::Perspective;
+		return;
+	}
+
+	// Steps up to 2^26 leave room for eight of them on top of an in-range value in 32 bits.
+	const double maxFixedStep = static_cast<double>(1 << 26);
+	const double scale = static_cast<double>(1 << 16);
+	m_mode = Mode::Affine;
+	for (int i = 0; i < 4; i++)
+	{
+		m_planes[i] = plane(channels1[i] * scale + scale / 2, channels2[i] * scale + scale / 2, channels3[i] * scale + scale / 2);
+		if (std::abs(m_planes[i].stepX) > maxFixedStep)
+			m_mode = Mode::Steep;
+		else
+			m_fixedStepX[i] = static_cast<int32_t>(std::llround(m_planes[i].stepX));
+	}
+}
+
+double ColorGradient::rowStart(const Plane& plane, int32_t y) const
+{
+	return plane.value - plane.stepX * m_originX + plane.stepY * (y - m_originY);
+}
+
+void ColorGradient::shadeSpan(Color* destination, int32_t x, int32_t y, int32_t count) const
+{
+	switch (m_mode)
+	{
+	case Mode::Constant:
+		fillSpan(destination, count, m_color);
+		break;
+
+	case Mode::Affine:
+	{
+		// The row start is rounded once and the span start is stepped to from it exactly, so the result doesn't
+		// depend on where the span begins. Values outside of the clamp only occur on rows without covered pixels.
+		const double limit = static_cast<double>(int64_t(1) << 60);
+		int32_t start[4];
+		for (int i = 0; i < 4; i++)
+		{
+			const int64_t value = std::llround(std::clamp(rowStart(m_planes[i], y), -limit, limit)) + static_cast<int64_t>(m_fixedStepX[i]) * x;
+			start[i] = static_cast<int32_t>(std::clamp<int64_t>(value, -(1 << 30), 1 << 30));
+		}
+
+		switch (simdLevel())
+		{
+#ifdef BITMAP_X86
+		case SimdLevel::Avx2:
+			shadeAffineAvx2(destination, start, m_fixedStepX, count);
+			break;
+		case SimdLevel::Sse41:
+			shadeAffineSse41(destination, start, m_fixedStepX, count);
+			break;
+#endif
+		default:
+			shadeAffineScalar(destination, start, m_fixedStepX, count);
+		}
+		break;
+	}
+
+	case Mode::Steep:
+		for (int32_t i = 0; i < count; i++)
+		{
+			uint8_t channels[4];
+			for (int j = 0; j < 4; j++)
+			{
+				const double value = rowStart(m_planes[j], y) + m_planes[j].stepX * (x + i);
+				channels[j] = static_cast<uint8_t>(static_cast<int32_t>(std::clamp(value, 0., static_cast<double>(0xffffff))) >> 16);
+			}
+			destination[i] = Color(channels[3], channels[2], channels[1], channels[0]);
+		}
+		break;
+
+	case Mode::Perspective:
+	{
+		// Relative to x = 0 of the row, like the fixed point modes.
+		float start[5];
+		float step[5];
+		for (int i = 0; i < 5; i++)
+		{
+			start[i] = static_cast<float>(rowStart(m_planes[i], y));
+			step[i] = static_cast<float>(m_planes[i].stepX);
+		}
+
+#ifdef BITMAP_X86
+		if (simdLevel() >= SimdLevel::Sse41)
+		{
+			shadePerspectiveSse41(destination, start, step, x, count);
+			break;
+		}
+#endif
+		shadePerspectiveScalar(destination, start, step, x, count);
+		break;
+	}
+	}
+}
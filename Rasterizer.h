@@ -0,0 +1,137 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+#include "Color.h"
+
+// Sets count pixels to the color with the widest stores available. Used for every solid span drawn into a bitmap.
+void fillSpan(Color* destination, int32_t count, Color color);
+
+// Produces the pixels covered by a triangle as one span per row, top to bottom.
+// The vertices are snapped to a grid of 1 / 2^subpixelBits pixels and a pixel is covered if the point at its integer
+// coordinates is inside of the triangle. Points exactly on an edge follow the top-left rule: they belong to the
+// triangle only if the edge is a top edge (horizontal, with the triangle below it) or a left edge. Triangles sharing
+// an edge therefore never cover the same pixel twice and leave no gaps.
+// The edge functions are stepped from row to row in fixed point and the span of a row is solved from them directly,
+// so empty parts of the bounding box cost nothing. Both windings are accepted.
+class TriangleRasterizer
+{
+public:
+	static constexpr int32_t subpixelBits = 4;
+	// Triangles with a coordinate further away from the origin than this aren't drawn, which keeps the fixed point
+	// edge functions inside of 64 bits.
+	static constexpr float maxCoordinate = static_cast<float>(1 << 25);
+
+	// Only pixels inside of [clipLeft, clipRight) x [clipTop, clipBottom) are produced.
+	TriangleRasterizer(float x1, float y1, float x2, float y2, float x3, float y3, int32_t clipLeft, int32_t clipTop, int32_t clipRight, int32_t clipBottom);
+
+	// Pixel bounds of the triangle inside of the clip rectangle. Empty if the triangle covers no pixels of it, but a
+	// triangle with non-empty bounds can still be too thin to cover any pixel.
+	int32_t left() const;
+	int32_t top() const;
+	int32_t right() const;
+	int32_t bottom() const;
+	bool empty() const;
+
+	// Finds the next row with covered pixels and returns them as [begin, end). Returns false once all rows are done.
+	bool nextSpan(int32_t& y, int32_t& begin, int32_t& end);
+
+	// Position of a coordinate on the subpixel grid.
+	static int64_t snap(float coordinate);
+
+private:
+	struct Edge
+	{
+		// Value of the edge function at (m_left, m_y), including the fill rule bias. Inside if >= 0.
+		int64_t value;
+		// Change of the value per pixel to the right and per row down.
+		int64_t stepX;
+		int64_t stepY;
+	};
+
+	Edge m_edges[3];
+	int32_t m_left;
+	int32_t m_right;
+	int32_t m_top;
+	int32_t m_y;
+	int32_t m_bottom;
+};
+
+// Interpolation of the vertex colors of a triangle, evaluated at integer pixel coordinates of the vertices snapped
+// like in TriangleRasterizer, so every covered pixel gets a mix of the vertex colors. Values are rounded to the
+// nearest integer.
+// If the vertices have the same w the colors are interpolated linearly in 16.16 fixed point. Otherwise w is the depth
+// of the vertex in a perspective projection and color / w and 1 / w are interpolated in float instead, with one
+// division per pixel, which is perspective correct.
+// The gradients are computed once per triangle and spans are shaded with SIMD when available. The value of a pixel
+// only depends on its coordinates, not on how its row is split into spans.
+class ColorGradient
+{
+public:
+	// Throws if a w isn't a positive finite number.
+	ColorGradient(float x1, float y1, float x2, float y2, float x3, float y3, Color color1, Color color2, Color color3, float w1 = 1, float w2 = 1, float w3 = 1);
+
+	// Writes the colors of pixels [x, x + count) of row y.
+	void shadeSpan(Color* destination, int32_t x, int32_t y, int32_t count) const;
+
+private:
+	enum class Mode
+	{
+		Constant,
+		// Fixed point, stepping from pixel to pixel.
+		Affine,
+		// Fixed point, but a step is too large for 32 bits. A row can't contain more than one covered pixel then, so
+		// every pixel is evaluated on its own.
+		Steep,
+		Perspective
+	};
+
+	// Plane of a value over the image: value + stepX * (x - m_originX) + stepY * (y - m_originY).
+	struct Plane
+	{
+		double value;
+		double stepX;
+		double stepY;
+	};
+
+	double rowStart(const Plane& plane, int32_t y) const;
+
+	Mode m_mode;
+	Color m_color;
+	// The channels in memory order (a, b, g, r). For the fixed point modes the values are scaled by 2^16 and
+	// include the rounding bias. For Perspective they are color / w and m_planes[4] is 1 / w.
+	Plane m_planes[5];
+	int32_t m_fixedStepX[4];
+	double m_originX;
+	double m_originY;
+};
+
+inline int32_t TriangleRasterizer::left() const
+{
+	return m_left;
+}
+
+inline int32_t TriangleRasterizer::top() const
+{
+	return m_top;
+}
+
+inline int32_t TriangleRasterizer::right() const
+{
+	return m_right;
+}
+
+inline int32_t TriangleRasterizer::bottom() const
+{
+	return m_bottom;
+}
+
+inline bool TriangleRasterizer::empty() const
+{
+	return m_y >= m_bottom;
+}
+
+inline int64_t TriangleRasterizer::snap(float coordinate)
+{
+	return std::lround(coordinate * static_cast<float>(1 << subpixelBits));
+}
@@ -0,0 +1,106 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <exception>
+
+ThreadPool::ThreadPool(size_t threadCount)
+	:m_stopping(false)
+{
+	for (size_t i = 1; i < threadCount; i++)
+		m_threads.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_condition.notify_all();
+	for (std::thread& thread : m_threads)
+		thread.join();
+}
+
+void ThreadPool::workerLoop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_condition.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+		if (m_tasks.empty())
+			return;
+
+		std::function<void()> task = std::move(m_tasks.front());
+		m_tasks.pop_front();
+		lock.unlock();
+		task();
+		lock.lock();
+	}
+}
+
+void ThreadPool::parallelFor(int32_t begin, int32_t end, int32_t grainSize, const std::function<void(int32_t, int32_t)>& body)
+{
+	if (begin >= end)
+		return;
+
+	const int32_t count = end - begin;
+	if (grainSize <= 0)
+		grainSize = std::max(1, count / static_cast<int32_t>(4 * threadCount()));
+
+	if (m_threads.empty() || grainSize >= count)
+	{
+		body(begin, end);
+		return;
+	}
+
+	// Only accessed while holding m_mutex. The tasks don't touch it after the last decrement, which makes it
+	// safe to keep on the stack.
+	int32_t remaining = (count + grainSize - 1) / grainSize;
+	std::exception_ptr error;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (int32_t chunkBegin = begin; chunkBegin < end; chunkBegin += grainSize)
+		{
+			const int32_t chunkEnd = std::min(end, chunkBegin + grainSize);
+			m_tasks.emplace_back([this, &body, &remaining, &error, chunkBegin, chunkEnd] {
+				std::exception_ptr chunkError;
+				try
+				{
+					body(chunkBegin, chunkEnd);
+				}
+				catch (...)
+				{
+					chunkError = std::current_exception();
+				}
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (chunkError && !error)
+					error = chunkError;
+				if (--remaining == 0)
+					m_condition.notify_all();
+			});
+		}
+	}
+	m_condition.notify_all();
+
+	// Instead of blocking, the calling thread runs queued tasks until its own chunks are finished. This also keeps
+	// nested calls from a worker thread from deadlocking.
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (remaining > 0)
+	{
+		if (m_tasks.empty())
+		{
+			m_condition.wait(lock);
+			continue;
+		}
+
+		std::function<void()> task = std::move(m_tasks.front());
+		m_tasks.pop_front();
+		lock.unlock();
+		task();
+		lock.lock();
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+}
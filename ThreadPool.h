@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// A fixed set of worker threads that is meant to be created once and passed to every filter call.
+class ThreadPool
+{
+public:
+	// The thread count includes the thread calling parallelFor, so a pool with a single thread never starts any workers.
+	explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
+	ThreadPool(const ThreadPool&) = delete;
+	~ThreadPool();
+
+	ThreadPool& operator= (const ThreadPool&) = delete;
+
+	size_t threadCount() const;
+
+	// Splits [begin, end) into chunks of grainSize elements and calls body(chunkBegin, chunkEnd) for each of them in parallel.
+	// A grainSize of 0 picks a size that gives every thread a few chunks. The calling thread takes part in the work and
+	// the function returns once all chunks are done. If body throws, the first exception is rethrown on the calling thread.
+	void parallelFor(int32_t begin, int32_t end, int32_t grainSize, const std::function<void(int32_t, int32_t)>& body);
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> m_threads;
+	std::deque<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_stopping;
+};
+
+inline size_t ThreadPool::threadCount() const
+{
+	return m_threads.size() + 1;
+}
+
+// Calls body(begin, end) on the calling thread if there is no pool.
+inline void parallelFor(ThreadPool* pool, int32_t begin, int32_t end, int32_t grainSize, const std::function<void(int32_t, int32_t)>& body)
+{
+	if (pool != nullptr)
+		pool->parallelFor(begin, end, grainSize, body);
+	else if (begin < end)
+		body(begin, end);
+}
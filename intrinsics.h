@@ -1,3 +1,6 @@
+#pragma once
+#include <algorithm>
+
 #ifdef _MSC_VER
 #include <intrin.h>
 
@@ -7,4 +10,64 @@ static inline int __builtin_ctz(unsigned x) {
     return (int)ret;
 }
 
-#endif
\ No newline at end of file
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BITMAP_X86
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only allow the use of intrinsics inside of functions compiled for the matching instruction set.
+// MSVC always allows them so the attributes are empty there.
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
+
+enum class SimdLevel
+{
+	Scalar,
+	Sse41,
+	Avx2
+};
+
+inline SimdLevel detectSimdLevel()
+{
+#if defined(BITMAP_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+	__cpuid(info, 1);
+	const bool sse41 = info[2] & (1 << 19);
+	// AVX registers are only usable if the OS saves them on context switches.
+	const bool avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+	bool avx2 = false;
+	if (avx && maxLeaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = info[1] & (1 << 5);
+	}
+	return avx2 ? SimdLevel::Avx2 : (sse41 ? SimdLevel::Sse41 : SimdLevel::Scalar);
+#elif defined(BITMAP_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return SimdLevel::Avx2;
+	if (__builtin_cpu_supports("sse4.1"))
+		return SimdLevel::Sse41;
+	return SimdLevel::Scalar;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+inline SimdLevel maxSimdLevel = SimdLevel::Avx2;
+
+// Instruction set used by the vectorized routines. Detected once at runtime and limited by maxSimdLevel.
+inline SimdLevel simdLevel()
+{
+	static const SimdLevel detected = detectSimdLevel();
+	return std::min(detected, maxSimdLevel);
+}